@@ -2,8 +2,21 @@ def can_build(env, platform):
     return not env["disable_3d"]
 
 
+def get_opts(platform):
+    from SCons.Variables import BoolVariable
+
+    return [
+        BoolVariable(
+            "many_bone_ik_single_precision",
+            "Run the ManyBoneIK solver hot path in single precision instead of double",
+            False,
+        ),
+    ]
+
+
 def configure(env):
-    pass
+    if env["many_bone_ik_single_precision"]:
+        env.Append(CPPDEFINES=["MANY_BONE_IK_SINGLE_PRECISION"])
 
 
 def get_doc_classes():
@@ -17,6 +30,8 @@ def get_doc_classes():
         "IKRay3D",
         "IKNode3D",
         "IKLimitCone3D",
+        "ManyBoneIK3DRegressionRunner",
+        "ManyBoneIK3DState",
     ]
 
 
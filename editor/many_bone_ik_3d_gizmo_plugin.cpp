@@ -89,104 +89,59 @@ void ManyBoneIK3DGizmoPlugin::redraw(EditorNode3DGizmo *p_gizmo) {
 	}
 	Color selected_bone_color = EDITOR_GET("editors/3d_gizmos/gizmo_colors/selected_bone");
 
-	int current_bone_index = 0;
-	Vector<int> bones_to_process = skeleton->get_parentless_bones();
-
-	while (bones_to_process.size() > current_bone_index) {
-		int current_bone_idx = bones_to_process[current_bone_index];
-
-		Color current_bone_color = (current_bone_idx == selected) ? selected_bone_color : bone_color;
-
-		for (const Ref<IKBoneSegment3D> &segmented_skeleton : many_bone_ik->get_segmented_skeletons()) {
-			if (segmented_skeleton.is_null()) {
-				continue;
-			}
-			Ref<IKBone3D> ik_bone = segmented_skeleton->get_ik_bone(current_bone_idx);
-			if (ik_bone.is_null() || ik_bone->get_constraint().is_null()) {
-				continue;
-			}
-			create_gizmo_mesh(current_bone_idx, ik_bone, p_gizmo, current_bone_color, skeleton, many_bone_ik);
-		}
-
-		current_bone_index++;
-
-		Vector<int> child_bones_vector;
-		child_bones_vector = skeleton->get_bone_children(current_bone_idx);
-		int child_bones_size = child_bones_vector.size();
-		for (int i = 0; i < child_bones_size; i++) {
-			// Something wrong.
-			if (child_bones_vector[i] < 0) {
-				continue;
-			}
-			// Add the bone's children to the list of bones to be processed.
-			bones_to_process.push_back(child_bones_vector[i]);
+	// Drop the buffers of nodes freed since the last redraw, so closed scenes do not keep their textures and materials alive.
+	LocalVector<ObjectID> freed_ids;
+	for (const KeyValue<ObjectID, KusudamaConeBuffer> &E : kusudama_cone_buffers) {
+		if (!ObjectDB::get_instance(E.key)) {
+			freed_ids.push_back(E.key);
 		}
 	}
-}
-
-void ManyBoneIK3DGizmoPlugin::create_gizmo_mesh(BoneId current_bone_idx, Ref<IKBone3D> ik_bone, EditorNode3DGizmo *p_gizmo, Color current_bone_color, Skeleton3D *many_bone_ik_skeleton, ManyBoneIK3D *p_many_bone_ik) {
-	Ref<IKKusudama3D> ik_kusudama = ik_bone->get_constraint();
-	if (ik_kusudama.is_null()) {
-		return;
+	for (const ObjectID &freed_id : freed_ids) {
+		kusudama_cone_buffers.erase(freed_id);
+	}
+	KusudamaConeBuffer &cone_buffer = kusudama_cone_buffers[many_bone_ik->get_instance_id()];
+	LocalVector<KusudamaInstance> instances;
+	LocalVector<PackedFloat32Array> cone_rows;
+	int32_t max_cone_count = 0;
+	// Draw the frames of the last finished solve; the bones themselves may be mid-solve on a worker thread.
+	for (const ManyBoneIK3D::PublishedConstraint &published : many_bone_ik->get_published_constraints()) {
+		KusudamaInstance instance;
+		instance.bone = published.bone;
+		instance.color = (instance.bone == selected) ? selected_bone_color : bone_color;
+		PackedFloat32Array cones;
+		if (!_get_kusudama_cones(published, skeleton, many_bone_ik, cones, instance.transform)) {
+			continue;
+		}
+		instance.cone_count = cones.size() / KUSUDAMA_FLOATS_PER_CONE;
+		max_cone_count = MAX(max_cone_count, instance.cone_count);
+		instances.push_back(instance);
+		cone_rows.push_back(cones);
 	}
-	const TypedArray<IKLimitCone3D> &open_cones = ik_kusudama->get_open_cones();
-	if (!open_cones.size()) {
+	if (instances.is_empty()) {
+		cone_buffer.materials.clear();
 		return;
 	}
-	BoneId parent_idx = many_bone_ik_skeleton->get_bone_parent(current_bone_idx);
-	LocalVector<int> bones;
-	LocalVector<float> weights;
-	bones.resize(4);
-	weights.resize(4);
-	for (int i = 0; i < 4; i++) {
-		bones[i] = 0;
-		weights[i] = 0;
-	}
-	bones[0] = parent_idx;
-	weights[0] = 1;
-
-	Transform3D constraint_relative_to_the_skeleton = p_many_bone_ik->get_relative_transform(p_many_bone_ik->get_owner()).affine_inverse() * many_bone_ik_skeleton->get_relative_transform(many_bone_ik_skeleton->get_owner()) * p_many_bone_ik->get_godot_skeleton_transform_inverse() * ik_bone->get_constraint_orientation_transform()->get_global_transform();
-	PackedFloat32Array kusudama_open_cones;
-	Ref<IKKusudama3D> kusudama = ik_bone->get_constraint();
-	for (int32_t cone_i = 0; cone_i < open_cones.size(); cone_i++) {
-		Ref<IKLimitCone3D> open_cone = open_cones[cone_i];
-		Vector3 control_point = open_cone->get_control_point();
-		PackedFloat32Array new_kusudama_open_cones;
-		new_kusudama_open_cones.resize(4 * 3);
-		new_kusudama_open_cones.fill(0.0f);
-		new_kusudama_open_cones.write[0] = control_point.x;
-		new_kusudama_open_cones.write[1] = control_point.y;
-		new_kusudama_open_cones.write[2] = control_point.z;
-		float radius = open_cone->get_radius();
-		new_kusudama_open_cones.write[3] = radius;
-
-		Vector3 tangent_center_1 = open_cone->get_tangent_circle_center_next_1();
-		new_kusudama_open_cones.write[4] = tangent_center_1.x;
-		new_kusudama_open_cones.write[5] = tangent_center_1.y;
-		new_kusudama_open_cones.write[6] = tangent_center_1.z;
-		float tangent_radius = open_cone->get_tangent_circle_radius_next();
-		new_kusudama_open_cones.write[7] = tangent_radius;
-
-		Vector3 tangent_center_2 = open_cone->get_tangent_circle_center_next_2();
-		new_kusudama_open_cones.write[8] = tangent_center_2.x;
-		new_kusudama_open_cones.write[9] = tangent_center_2.y;
-		new_kusudama_open_cones.write[10] = tangent_center_2.z;
-		new_kusudama_open_cones.write[11] = tangent_radius;
+	_update_kusudama_cone_texture(cone_buffer, cone_rows, max_cone_count);
 
-		kusudama_open_cones.append_array(new_kusudama_open_cones);
+	HashSet<BoneId> drawn_bones;
+	for (uint32_t instance_i = 0; instance_i < instances.size(); instance_i++) {
+		const KusudamaInstance &instance = instances[instance_i];
+		Ref<ShaderMaterial> kusudama_material = _get_kusudama_material(cone_buffer, instance.bone, instance_i, instance.cone_count, instance.color);
+		p_gizmo->add_mesh(kusudama_mesh, kusudama_material, instance.transform);
+		drawn_bones.insert(instance.bone);
 	}
-	if (current_bone_idx >= many_bone_ik_skeleton->get_bone_count()) {
-		return;
-	}
-	if (current_bone_idx == -1) {
-		return;
-	}
-	if (parent_idx >= many_bone_ik_skeleton->get_bone_count()) {
-		return;
+	LocalVector<BoneId> stale_bones;
+	for (const KeyValue<BoneId, KusudamaMaterial> &E : cone_buffer.materials) {
+		if (!drawn_bones.has(E.key)) {
+			stale_bones.push_back(E.key);
+		}
 	}
-	if (parent_idx <= -1) {
-		return;
+	for (BoneId bone : stale_bones) {
+		cone_buffer.materials.erase(bone);
 	}
+}
+
+Ref<ArrayMesh> ManyBoneIK3DGizmoPlugin::_create_kusudama_mesh() const {
 	// Code copied from the SphereMesh.
 	int rings = 8;
 
@@ -236,17 +191,12 @@ void ManyBoneIK3DGizmoPlugin::create_gizmo_mesh(BoneId current_bone_idx, Ref<IKB
 		prevrow = thisrow;
 		thisrow = point;
 	}
-	if (!indices.size()) {
-		return;
-	}
 	Ref<SurfaceTool> surface_tool;
 	surface_tool.instantiate();
 	surface_tool->begin(Mesh::PRIMITIVE_TRIANGLES);
 	const int32_t MESH_CUSTOM_0 = 0;
 	surface_tool->set_custom_format(MESH_CUSTOM_0, SurfaceTool::CustomFormat::CUSTOM_RGBA_HALF);
 	for (int32_t point_i = 0; point_i < points.size(); point_i++) {
-		surface_tool->set_bones(bones);
-		surface_tool->set_weights(weights);
 		Color c;
 		c.r = normals[point_i].x;
 		c.g = normals[point_i].y;
@@ -259,20 +209,113 @@ void ManyBoneIK3DGizmoPlugin::create_gizmo_mesh(BoneId current_bone_idx, Ref<IKB
 	for (int32_t index_i : indices) {
 		surface_tool->add_index(index_i);
 	}
-	Ref<ShaderMaterial> kusudama_material;
-	kusudama_material.instantiate();
-	kusudama_material->set_shader(kusudama_shader);
-	kusudama_material->set_shader_parameter("cone_sequence", kusudama_open_cones);
-	int32_t cone_count = kusudama->get_open_cones().size();
-	kusudama_material->set_shader_parameter("cone_count", cone_count);
-	kusudama_material->set_shader_parameter("kusudama_color", current_bone_color);
-	p_gizmo->add_mesh(
-			surface_tool->commit(Ref<Mesh>(), RS::ARRAY_CUSTOM_RGBA_HALF << RS::ARRAY_FORMAT_CUSTOM0_SHIFT),
-			kusudama_material, constraint_relative_to_the_skeleton);
+	return surface_tool->commit(Ref<ArrayMesh>(), RS::ARRAY_CUSTOM_RGBA_HALF << RS::ARRAY_FORMAT_CUSTOM0_SHIFT);
+}
+
+void ManyBoneIK3DGizmoPlugin::_update_kusudama_cone_texture(KusudamaConeBuffer &r_cone_buffer, const LocalVector<PackedFloat32Array> &p_cone_rows, int32_t p_max_cone_count) {
+	const int32_t texels_per_cone = KUSUDAMA_FLOATS_PER_CONE / 4;
+	int32_t width = MAX(p_max_cone_count * texels_per_cone, 1);
+	int32_t height = p_cone_rows.size();
+	PackedFloat32Array data;
+	data.resize(width * height * 4);
+	data.fill(0.0f);
+	float *data_write = data.ptrw();
+	for (uint32_t row_i = 0; row_i < p_cone_rows.size(); row_i++) {
+		memcpy(data_write + row_i * width * 4, p_cone_rows[row_i].ptr(), p_cone_rows[row_i].size() * sizeof(float));
+	}
+	if (r_cone_buffer.texture.is_valid() && r_cone_buffer.width == width && r_cone_buffer.data == data) {
+		return;
+	}
+	PackedByteArray bytes;
+	bytes.resize(data.size() * sizeof(float));
+	memcpy(bytes.ptrw(), data.ptr(), bytes.size());
+	Ref<Image> image = Image::create_from_data(width, height, false, Image::FORMAT_RGBAF, bytes);
+	if (r_cone_buffer.texture.is_valid() && r_cone_buffer.texture->get_width() == width && r_cone_buffer.texture->get_height() == height) {
+		r_cone_buffer.texture->update(image);
+	} else {
+		r_cone_buffer.texture = ImageTexture::create_from_image(image);
+		for (KeyValue<BoneId, KusudamaMaterial> &E : r_cone_buffer.materials) {
+			E.value.material->set_shader_parameter("cone_data", r_cone_buffer.texture);
+		}
+	}
+	r_cone_buffer.data = data;
+	r_cone_buffer.width = width;
+}
+
+Ref<ShaderMaterial> ManyBoneIK3DGizmoPlugin::_get_kusudama_material(KusudamaConeBuffer &r_cone_buffer, BoneId p_bone, int32_t p_cone_row, int32_t p_cone_count, const Color &p_color) {
+	KusudamaMaterial &cached = r_cone_buffer.materials[p_bone];
+	if (cached.material.is_null()) {
+		cached.material.instantiate();
+		cached.material->set_shader(kusudama_shader);
+		cached.material->set_shader_parameter("cone_data", r_cone_buffer.texture);
+	} else if (cached.cone_row == p_cone_row && cached.cone_count == p_cone_count && cached.color == p_color) {
+		return cached.material;
+	}
+	// The cones themselves live in the shared texture, so a material only changes when its row, count or color does.
+	cached.cone_row = p_cone_row;
+	cached.cone_count = p_cone_count;
+	cached.color = p_color;
+	cached.material->set_shader_parameter("cone_row", p_cone_row);
+	cached.material->set_shader_parameter("cone_count", p_cone_count);
+	cached.material->set_shader_parameter("kusudama_color", p_color);
+	return cached.material;
+}
+
+bool ManyBoneIK3DGizmoPlugin::_get_kusudama_cones(const ManyBoneIK3D::PublishedConstraint &p_constraint, Skeleton3D *many_bone_ik_skeleton, ManyBoneIK3D *p_many_bone_ik, PackedFloat32Array &r_cones, Transform3D &r_transform) {
+	const BoneId current_bone_idx = p_constraint.bone;
+	Ref<IKKusudama3D> ik_kusudama = p_constraint.constraint;
+	if (ik_kusudama.is_null()) {
+		return false;
+	}
+	const TypedArray<IKLimitCone3D> &open_cones = ik_kusudama->get_open_cones();
+	if (!open_cones.size()) {
+		return false;
+	}
+	if (current_bone_idx >= many_bone_ik_skeleton->get_bone_count()) {
+		return false;
+	}
+	if (current_bone_idx == -1) {
+		return false;
+	}
+	BoneId parent_idx = many_bone_ik_skeleton->get_bone_parent(current_bone_idx);
+	if (parent_idx >= many_bone_ik_skeleton->get_bone_count()) {
+		return false;
+	}
+	if (parent_idx <= -1) {
+		return false;
+	}
+
+	r_transform = p_many_bone_ik->get_relative_transform(p_many_bone_ik->get_owner()).affine_inverse() * many_bone_ik_skeleton->get_relative_transform(many_bone_ik_skeleton->get_owner()) * p_many_bone_ik->get_godot_skeleton_transform_inverse() * p_constraint.orientation;
+	r_cones.resize(open_cones.size() * KUSUDAMA_FLOATS_PER_CONE);
+	float *cone_write = r_cones.ptrw();
+	for (int32_t cone_i = 0; cone_i < open_cones.size(); cone_i++) {
+		Ref<IKLimitCone3D> open_cone = open_cones[cone_i];
+		float *cone = cone_write + cone_i * KUSUDAMA_FLOATS_PER_CONE;
+		Vector3 control_point = open_cone->get_control_point();
+		cone[0] = control_point.x;
+		cone[1] = control_point.y;
+		cone[2] = control_point.z;
+		cone[3] = open_cone->get_radius();
+
+		Vector3 tangent_center_1 = open_cone->get_tangent_circle_center_next_1();
+		float tangent_radius = open_cone->get_tangent_circle_radius_next();
+		cone[4] = tangent_center_1.x;
+		cone[5] = tangent_center_1.y;
+		cone[6] = tangent_center_1.z;
+		cone[7] = tangent_radius;
+
+		Vector3 tangent_center_2 = open_cone->get_tangent_circle_center_next_2();
+		cone[8] = tangent_center_2.x;
+		cone[9] = tangent_center_2.y;
+		cone[10] = tangent_center_2.z;
+		cone[11] = tangent_radius;
+	}
+	return true;
 }
 
 ManyBoneIK3DGizmoPlugin::ManyBoneIK3DGizmoPlugin() {
 	kusudama_shader->set_code(MANY_BONE_IKKUSUDAMA_SHADER);
+	kusudama_mesh = _create_kusudama_mesh();
 }
 
 int32_t ManyBoneIK3DGizmoPlugin::get_priority() const {
@@ -36,6 +36,7 @@
 #include "many_bone_ik_shader.h"
 
 #include "core/templates/hash_map.h"
+#include "core/templates/hash_set.h"
 #include "core/templates/local_vector.h"
 #include "editor/editor_inspector.h"
 #include "editor/editor_node.h"
@@ -48,6 +49,7 @@
 #include "scene/3d/mesh_instance_3d.h"
 #include "scene/3d/node_3d.h"
 #include "scene/3d/skeleton_3d.h"
+#include "scene/resources/image_texture.h"
 #include "scene/resources/immediate_mesh.h"
 #include "scene/resources/material.h"
 
@@ -59,6 +61,28 @@ class Button;
 class ManyBoneIK3DGizmoPlugin : public EditorNode3DGizmoPlugin {
 	GDCLASS(ManyBoneIK3DGizmoPlugin, EditorNode3DGizmoPlugin);
 	Ref<Shader> kusudama_shader = memnew(Shader);
+	// One unit sphere shared by every kusudama. The cones of all bones of a ManyBoneIK3D are packed into one float texture,
+	// and each bone keeps a small material that only selects its row.
+	Ref<ArrayMesh> kusudama_mesh;
+	struct KusudamaMaterial {
+		Ref<ShaderMaterial> material;
+		int32_t cone_row = -1;
+		int32_t cone_count = 0;
+		Color color;
+	};
+	struct KusudamaConeBuffer {
+		PackedFloat32Array data;
+		int32_t width = 0;
+		Ref<ImageTexture> texture;
+		HashMap<BoneId, KusudamaMaterial> materials;
+	};
+	struct KusudamaInstance {
+		BoneId bone = -1;
+		int32_t cone_count = 0;
+		Transform3D transform;
+		Color color;
+	};
+	HashMap<ObjectID, KusudamaConeBuffer> kusudama_cone_buffers;
 
 	Ref<StandardMaterial3D> unselected_mat;
 	Ref<ShaderMaterial> selected_mat;
@@ -78,18 +102,22 @@ protected:
 
 public:
 	const Color bone_color = EditorSettings::get_singleton()->get("editors/3d_gizmos/gizmo_colors/skeleton");
-	const int32_t KUSUDAMA_MAX_CONES = 10;
+	static const int32_t KUSUDAMA_FLOATS_PER_CONE = 4 * 3;
 	bool has_gizmo(Node3D *p_spatial) override;
 	String get_gizmo_name() const override;
 	void redraw(EditorNode3DGizmo *p_gizmo) override;
 	ManyBoneIK3DGizmoPlugin();
 	int32_t get_priority() const override;
-	void create_gizmo_mesh(BoneId current_bone_idx, Ref<IKBone3D> ik_bone, EditorNode3DGizmo *p_gizmo, Color current_bone_color, Skeleton3D *many_bone_ik_skeleton, ManyBoneIK3D *p_many_bone_ik);
 	int subgizmos_intersect_ray(const EditorNode3DGizmo *p_gizmo, Camera3D *p_camera, const Vector2 &p_point) const override;
 	Transform3D get_subgizmo_transform(const EditorNode3DGizmo *p_gizmo, int p_id) const override;
 	void set_subgizmo_transform(const EditorNode3DGizmo *p_gizmo, int p_id, Transform3D p_transform) override;
 	void commit_subgizmos(const EditorNode3DGizmo *p_gizmo, const Vector<int> &p_ids, const Vector<Transform3D> &p_restore, bool p_cancel) override;
 
+	Ref<ArrayMesh> _create_kusudama_mesh() const;
+	bool _get_kusudama_cones(const ManyBoneIK3D::PublishedConstraint &p_constraint, Skeleton3D *many_bone_ik_skeleton, ManyBoneIK3D *p_many_bone_ik, PackedFloat32Array &r_cones, Transform3D &r_transform);
+	void _update_kusudama_cone_texture(KusudamaConeBuffer &r_cone_buffer, const LocalVector<PackedFloat32Array> &p_cone_rows, int32_t p_max_cone_count);
+	Ref<ShaderMaterial> _get_kusudama_material(KusudamaConeBuffer &r_cone_buffer, BoneId p_bone, int32_t p_cone_row, int32_t p_cone_count, const Color &p_color);
+
 	void edit_mode_toggled(const bool pressed);
 	void _subgizmo_selection_change();
 	void _update_gizmo_visible();
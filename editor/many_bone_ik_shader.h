@@ -42,15 +42,15 @@ uniform int cone_count = 0;
 // 0,0,0 is the center of the kusudama. The kusudamas have their own bases that automatically get reoriented such that +y points in the direction that is the weighted average of the limitcones on the kusudama.
 // But, if you have a kusuduma with just 1 open_cone, then in general that open_cone should be 0,1,0 in the kusudama's basis unless the user has specifically specified otherwise.
 
-uniform vec4 cone_sequence[30];
-
-// This shader can display up to 10 cones (represented by 30 4d vectors)
-// Each group of 4 represents the xyz coordinates of the cone direction
-// vector in model space and the fourth element represents radius
-
-// TODO: fire 2022-05-26
-// Use a texture to store bone parameters.
-// Use the uv to get the row of the bone.
+// Cone data for every kusudama of the ManyBoneIK3D, one row per constrained bone.
+// Each open cone takes three texels: the cone direction in model space with its radius in alpha,
+// followed by the two tangent circles to the next cone. Rows are as wide as the bone with the most cones.
+uniform highp sampler2D cone_data : filter_nearest, repeat_disable;
+uniform int cone_row = 0;
+
+vec4 cone_sequence(in int index) {
+	return texelFetch(cone_data, ivec2(index, cone_row), 0);
+}
 
 varying vec3 normal_model_dir;
 varying vec4 vert_model_color;
@@ -114,7 +114,7 @@ int is_in_cone(in vec3 normal_dir, in vec4 cone, in float boundary_width) {
 vec4 color_allowed(in vec3 normal_dir,  in int cone_counts, in float boundary_width) {
 	int current_condition = -3;
 	if (cone_counts == 1) {
-		vec4 cone = cone_sequence[0];
+		vec4 cone = cone_sequence(0);
 		int in_cone = is_in_cone(normal_dir, cone, boundary_width);
 		bool is_in_cone = in_cone == 0;
 		if (is_in_cone) {
@@ -131,10 +131,10 @@ vec4 color_allowed(in vec3 normal_dir,  in int cone_counts, in float boundary_wi
 		for(int i=0; i < (cone_counts-1)*3; i=i+3) {
 			normal_dir = normalize(normal_dir);
 
-			vec4 cone_1 = cone_sequence[i+0];
-			vec4 tangent_1 = cone_sequence[i+1];
-			vec4 tangent_2 = cone_sequence[i+2];
-			vec4 cone_2 = cone_sequence[i+3];
+			vec4 cone_1 = cone_sequence(i+0);
+			vec4 tangent_1 = cone_sequence(i+1);
+			vec4 tangent_2 = cone_sequence(i+2);
+			vec4 cone_2 = cone_sequence(i+3);
 
 			int inCone1 = is_in_cone(normal_dir, cone_1, boundary_width);
 			if (inCone1 == 0) {
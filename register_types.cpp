@@ -35,6 +35,8 @@
 #include "src/ik_effector_template_3d.h"
 #include "src/ik_kusudama_3d.h"
 #include "src/many_bone_ik_3d.h"
+#include "src/many_bone_ik_3d_regression_runner.h"
+#include "src/many_bone_ik_3d_state.h"
 
 #ifdef TOOLS_ENABLED
 #include "editor/many_bone_ik_3d_gizmo_plugin.h"
@@ -58,6 +60,8 @@ void initialize_many_bone_ik_module(ModuleInitializationLevel p_level) {
 		GDREGISTER_CLASS(IKKusudama3D);
 		GDREGISTER_CLASS(IKRay3D);
 		GDREGISTER_CLASS(IKLimitCone3D);
+		GDREGISTER_CLASS(ManyBoneIK3DRegressionRunner);
+		GDREGISTER_CLASS(ManyBoneIK3DState);
 	}
 }
 
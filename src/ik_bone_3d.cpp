@@ -54,6 +54,15 @@ void IKBone3D::set_parent(const Ref<IKBone3D> &p_parent) {
 	}
 }
 
+void IKBone3D::clear_links() {
+	parent.unref();
+	children.clear();
+	if (pin.is_valid()) {
+		pin->for_bone.unref();
+		pin.unref();
+	}
+}
+
 void IKBone3D::update_default_bone_direction_transform(Skeleton3D *p_skeleton) {
 	Vector3 child_centroid;
 	int child_count = 0;
@@ -158,24 +167,39 @@ Transform3D IKBone3D::get_bone_direction_global_pose() const {
 	return bone_direction_transform->get_global_transform();
 }
 
-void IKBone3D::set_initial_pose(Skeleton3D *p_skeleton) {
-	ERR_FAIL_NULL(p_skeleton);
+// Copies the skeleton pose into the local transform without propagating it to the descendants.
+// Returns true if the pose differs from the one read last time.
+bool IKBone3D::set_initial_pose(Skeleton3D *p_skeleton) {
+	ERR_FAIL_NULL_V(p_skeleton, false);
 	if (bone_id == -1) {
-		return;
+		return false;
 	}
-	Transform3D bone_origin_to_parent_origin = p_skeleton->get_bone_pose(bone_id);
-	set_pose(bone_origin_to_parent_origin);
+	return godot_skeleton_aligned_transform->set_transform_deferred(p_skeleton->get_bone_pose(bone_id));
 }
 
 void IKBone3D::set_skeleton_bone_pose(Skeleton3D *p_skeleton) {
 	ERR_FAIL_NULL(p_skeleton);
 	Transform3D bone_to_parent = get_pose();
-	p_skeleton->set_bone_pose_position(bone_id, bone_to_parent.origin);
 	if (!bone_to_parent.basis.is_finite()) {
 		bone_to_parent.basis = Basis();
 	}
-	p_skeleton->set_bone_pose_rotation(bone_id, bone_to_parent.basis.get_rotation_quaternion());
-	p_skeleton->set_bone_pose_scale(bone_id, bone_to_parent.basis.get_scale());
+	write_skeleton_bone_pose(p_skeleton, bone_id, bone_to_parent);
+}
+
+void IKBone3D::write_skeleton_bone_pose(Skeleton3D *p_skeleton, BoneId p_bone, const Transform3D &p_pose) {
+	ERR_FAIL_NULL(p_skeleton);
+	// Every setter invalidates the skeleton's pose cache, so only write the components that changed.
+	if (p_skeleton->get_bone_pose_position(p_bone) != p_pose.origin) {
+		p_skeleton->set_bone_pose_position(p_bone, p_pose.origin);
+	}
+	Quaternion rotation = p_pose.basis.get_rotation_quaternion();
+	if (p_skeleton->get_bone_pose_rotation(p_bone) != rotation) {
+		p_skeleton->set_bone_pose_rotation(p_bone, rotation);
+	}
+	Vector3 scale = p_pose.basis.get_scale();
+	if (p_skeleton->get_bone_pose_scale(p_bone) != scale) {
+		p_skeleton->set_bone_pose_scale(p_bone, scale);
+	}
 }
 
 void IKBone3D::create_pin() {
@@ -195,8 +219,27 @@ void IKBone3D::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_constraint_twist_transform"), &IKBone3D::get_constraint_twist_transform);
 }
 
+void IKBone3D::_create_transforms(IKNode3DPool *p_pool) {
+	if (p_pool) {
+		constraint_orientation_transform = p_pool->acquire();
+		constraint_twist_transform = p_pool->acquire();
+		godot_skeleton_aligned_transform = p_pool->acquire();
+		bone_direction_transform = p_pool->acquire();
+		return;
+	}
+	constraint_orientation_transform.instantiate();
+	constraint_twist_transform.instantiate();
+	godot_skeleton_aligned_transform.instantiate();
+	bone_direction_transform.instantiate();
+}
+
+IKBone3D::IKBone3D() {
+	_create_transforms(nullptr);
+}
+
 IKBone3D::IKBone3D(StringName p_bone, Skeleton3D *p_skeleton, const Ref<IKBone3D> &p_parent, Vector<Ref<IKEffectorTemplate3D>> &p_pins, float p_default_dampening,
 		ManyBoneIK3D *p_many_bone_ik) {
+	_create_transforms(p_many_bone_ik ? p_many_bone_ik->get_node_pool() : nullptr);
 	ERR_FAIL_NULL(p_skeleton);
 
 	default_dampening = p_default_dampening;
@@ -214,6 +257,7 @@ IKBone3D::IKBone3D(StringName p_bone, Skeleton3D *p_skeleton, const Ref<IKBone3D
 			create_pin();
 			Ref<IKEffector3D> effector = get_pin();
 			effector->set_target_node(p_skeleton, elem->get_target_node());
+			effector->set_pole_node(elem->get_pole_node());
 			effector->set_motion_propagation_factor(elem->get_motion_propagation_factor());
 			effector->set_weight(elem->get_weight());
 			effector->set_direction_priorities(elem->get_direction_priorities());
@@ -224,24 +268,6 @@ IKBone3D::IKBone3D(StringName p_bone, Skeleton3D *p_skeleton, const Ref<IKBone3D
 
 	float predamp = 1.0 - get_stiffness();
 	dampening = get_parent().is_null() ? Math_PI : predamp * p_default_dampening;
-	float iterations = p_many_bone_ik->get_iterations_per_frame();
-	if (get_constraint().is_null()) {
-		Ref<IKKusudama3D> new_constraint;
-		new_constraint.instantiate();
-		add_constraint(new_constraint);
-	}
-	float returnfulness = get_constraint()->get_resistance();
-	float falloff = 0.2f;
-	half_returnfulness_dampened.resize(iterations);
-	cos_half_returnfulness_dampened.resize(iterations);
-	float iterations_pow = Math::pow(iterations, falloff * iterations * returnfulness);
-	for (float i = 0; i < iterations; i++) {
-		float iteration_scalar = ((iterations_pow)-Math::pow(i, falloff * iterations * returnfulness)) / (iterations_pow);
-		float iteration_return_clamp = iteration_scalar * returnfulness * dampening;
-		float cos_iteration_return_clamp = Math::cos(iteration_return_clamp / 2.0);
-		half_returnfulness_dampened.write[i] = iteration_return_clamp;
-		cos_half_returnfulness_dampened.write[i] = cos_iteration_return_clamp;
-	}
 }
 
 float IKBone3D::get_cos_half_dampen() const {
@@ -298,22 +324,6 @@ bool IKBone3D::is_axially_constrained() {
 	return get_constraint()->is_axially_constrained();
 }
 
-Vector<float> &IKBone3D::get_cos_half_returnfullness_dampened() {
-	return cos_half_returnfulness_dampened;
-}
-
-void IKBone3D::set_cos_half_returnfullness_dampened(const Vector<float> &p_value) {
-	cos_half_returnfulness_dampened = p_value;
-}
-
-Vector<float> &IKBone3D::get_half_returnfullness_dampened() {
-	return half_returnfulness_dampened;
-}
-
-void IKBone3D::set_half_returnfullness_dampened(const Vector<float> &p_value) {
-	half_returnfulness_dampened = p_value;
-}
-
 void IKBone3D::set_stiffness(double p_stiffness) {
 	stiffness = p_stiffness;
 }
@@ -55,10 +55,6 @@ class IKBone3D : public Resource {
 	float default_dampening = Math_PI;
 	float dampening = get_parent().is_null() ? Math_PI : default_dampening;
 	float cos_half_dampen = Math::cos(dampening / 2.0f);
-	double cos_half_return_damp = 0.0f;
-	double return_damp = 0.0f;
-	Vector<float> cos_half_returnfulness_dampened;
-	Vector<float> half_returnfulness_dampened;
 	double stiffness = 0.0;
 	Ref<IKKusudama3D> constraint;
 	// In the space of the local parent bone transform.
@@ -66,19 +62,18 @@ class IKBone3D : public Resource {
 	// Can be independent and should be calculated
 	// to keep -y to be the opposite of its bone forward orientation
 	// To avoid singularity that is ambiguous.
-	Ref<IKNode3D> constraint_orientation_transform = Ref<IKNode3D>(memnew(IKNode3D()));
-	Ref<IKNode3D> constraint_twist_transform = Ref<IKNode3D>(memnew(IKNode3D()));
-	Ref<IKNode3D> godot_skeleton_aligned_transform = Ref<IKNode3D>(memnew(IKNode3D())); // The bone's actual transform.
-	Ref<IKNode3D> bone_direction_transform = Ref<IKNode3D>(memnew(IKNode3D())); // Physical direction of the bone. Calculate Y is the bone up.
+	Ref<IKNode3D> constraint_orientation_transform;
+	Ref<IKNode3D> constraint_twist_transform;
+	Ref<IKNode3D> godot_skeleton_aligned_transform; // The bone's actual transform.
+	Ref<IKNode3D> bone_direction_transform; // Physical direction of the bone. Calculate Y is the bone up.
+
+	// Takes the four transforms from the modifier's pool when there is one.
+	void _create_transforms(IKNode3DPool *p_pool);
 
 protected:
 	static void _bind_methods();
 
 public:
-	Vector<float> &get_cos_half_returnfullness_dampened();
-	void set_cos_half_returnfullness_dampened(const Vector<float> &p_value);
-	Vector<float> &get_half_returnfullness_dampened();
-	void set_half_returnfullness_dampened(const Vector<float> &p_value);
 	void set_stiffness(double p_stiffness);
 	double get_stiffness() const;
 	bool is_axially_constrained();
@@ -96,6 +91,8 @@ public:
 	void set_bone_id(BoneId p_bone_id, Skeleton3D *p_skeleton = nullptr);
 	BoneId get_bone_id() const;
 	void set_parent(const Ref<IKBone3D> &p_parent);
+	// Drops the references to the parent, children and pin, which would otherwise keep a discarded rig alive.
+	void clear_links();
 	Ref<IKBone3D> get_parent() const;
 	void set_pin(const Ref<IKEffector3D> &p_pin);
 	Ref<IKEffector3D> get_pin() const;
@@ -103,12 +100,13 @@ public:
 	Transform3D get_global_pose() const;
 	void set_pose(const Transform3D &p_transform);
 	Transform3D get_pose() const;
-	void set_initial_pose(Skeleton3D *p_skeleton);
+	bool set_initial_pose(Skeleton3D *p_skeleton);
 	void set_skeleton_bone_pose(Skeleton3D *p_skeleton);
+	static void write_skeleton_bone_pose(Skeleton3D *p_skeleton, BoneId p_bone, const Transform3D &p_pose);
 	void create_pin();
 	bool is_pinned() const;
 	Ref<IKNode3D> get_ik_transform();
-	IKBone3D() {}
+	IKBone3D();
 	IKBone3D(StringName p_bone, Skeleton3D *p_skeleton, const Ref<IKBone3D> &p_parent, Vector<Ref<IKEffectorTemplate3D>> &p_pins, float p_default_dampening = Math_PI, ManyBoneIK3D *p_many_bone_ik = nullptr);
 	~IKBone3D() {}
 	float get_cos_half_dampen() const;
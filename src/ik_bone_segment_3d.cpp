@@ -30,6 +30,8 @@
 
 #include "ik_bone_segment_3d.h"
 
+#include "core/object/worker_thread_pool.h"
+#include "core/os/thread.h"
 #include "core/string/string_builder.h"
 #include "ik_effector_3d.h"
 #include "ik_kusudama_3d.h"
@@ -71,7 +73,7 @@ void IKBoneSegment3D::create_bone_list(Vector<Ref<IKBone3D>> &p_list, bool p_rec
 	p_list.append_array(list);
 }
 
-void IKBoneSegment3D::update_pinned_list(Vector<Vector<double>> &r_weights) {
+void IKBoneSegment3D::update_pinned_list(Vector<Vector<ik_real_t>> &r_weights) {
 	for (int32_t chain_i = 0; chain_i < child_segments.size(); chain_i++) {
 		Ref<IKBoneSegment3D> chain = child_segments[chain_i];
 		chain->update_pinned_list(r_weights);
@@ -79,30 +81,29 @@ void IKBoneSegment3D::update_pinned_list(Vector<Vector<double>> &r_weights) {
 	if (is_pinned()) {
 		effector_list.push_back(tip->get_pin());
 	}
-	double motion_propagation_factor = is_pinned() ? tip->get_pin()->motion_propagation_factor : 1.0;
+	ik_real_t motion_propagation_factor = is_pinned() ? tip->get_pin()->motion_propagation_factor : 1.0;
 	if (motion_propagation_factor > 0.0) {
-		for (Ref<IKBoneSegment3D> child : child_segments) {
+		for (const Ref<IKBoneSegment3D> &child : child_segments) {
 			effector_list.append_array(child->effector_list);
 		}
 	}
 }
 
-void IKBoneSegment3D::_update_optimal_rotation(Ref<IKBone3D> p_for_bone, double p_damp, bool p_translate, bool p_constraint_mode, int32_t current_iteration, int32_t total_iterations) {
+void IKBoneSegment3D::_update_optimal_rotation(const Ref<IKBone3D> &p_for_bone, ik_real_t p_cos_half_damp, bool p_translate, bool p_constraint_mode) {
 	ERR_FAIL_NULL(p_for_bone);
 	_update_target_headings(p_for_bone, &heading_weights, &target_headings);
-	_update_tip_headings(p_for_bone, &tip_headings);
-	_set_optimal_rotation(p_for_bone, &tip_headings, &target_headings, &heading_weights, p_damp, p_translate, p_constraint_mode);
+	_set_optimal_rotation(p_for_bone, &tip_headings, &target_headings, &heading_weights, p_cos_half_damp, p_translate, p_constraint_mode);
 }
 
-Quaternion IKBoneSegment3D::clamp_to_cos_half_angle(Quaternion p_quat, double p_cos_half_angle) {
+Quaternion IKBoneSegment3D::clamp_to_cos_half_angle(Quaternion p_quat, ik_real_t p_cos_half_angle) {
 	if (p_quat.w < 0.0) {
 		p_quat = p_quat * -1;
 	}
-	double previous_coefficient = (1.0 - (p_quat.w * p_quat.w));
+	ik_real_t previous_coefficient = (1.0 - (p_quat.w * p_quat.w));
 	if (p_cos_half_angle <= p_quat.w || previous_coefficient == 0.0) {
 		return p_quat;
 	} else {
-		double composite_coefficient = Math::sqrt((1.0 - (p_cos_half_angle * p_cos_half_angle)) / previous_coefficient);
+		ik_real_t composite_coefficient = Math::sqrt((1.0 - (p_cos_half_angle * p_cos_half_angle)) / previous_coefficient);
 		p_quat.w = p_cos_half_angle;
 		p_quat.x *= composite_coefficient;
 		p_quat.y *= composite_coefficient;
@@ -111,14 +112,14 @@ Quaternion IKBoneSegment3D::clamp_to_cos_half_angle(Quaternion p_quat, double p_
 	return p_quat;
 }
 
-float IKBoneSegment3D::_get_manual_msd(const PackedVector3Array &r_htip, const PackedVector3Array &r_htarget, const Vector<double> &p_weights) {
-	float manual_RMSD = 0.0f;
-	float w_sum = 0.0f;
+ik_real_t IKBoneSegment3D::_get_manual_msd(const PackedVector3Array &r_htip, const PackedVector3Array &r_htarget, const Vector<ik_real_t> &p_weights) {
+	ik_real_t manual_RMSD = 0.0;
+	ik_real_t w_sum = 0.0;
 	for (int i = 0; i < r_htarget.size(); i++) {
-		float x_d = r_htarget[i].x - r_htip[i].x;
-		float y_d = r_htarget[i].y - r_htip[i].y;
-		float z_d = r_htarget[i].z - r_htip[i].z;
-		float mag_sq = p_weights[i] * (x_d * x_d + y_d * y_d + z_d * z_d);
+		ik_real_t x_d = r_htarget[i].x - r_htip[i].x;
+		ik_real_t y_d = r_htarget[i].y - r_htip[i].y;
+		ik_real_t z_d = r_htarget[i].z - r_htip[i].z;
+		ik_real_t mag_sq = p_weights[i] * (x_d * x_d + y_d * y_d + z_d * z_d);
 		manual_RMSD += mag_sq;
 		w_sum += p_weights[i];
 	}
@@ -126,67 +127,102 @@ float IKBoneSegment3D::_get_manual_msd(const PackedVector3Array &r_htip, const P
 	return manual_RMSD;
 }
 
-void IKBoneSegment3D::_set_optimal_rotation(Ref<IKBone3D> p_for_bone, PackedVector3Array *r_htip, PackedVector3Array *r_htarget, Vector<double> *r_weights, float p_dampening, bool p_translate, bool p_constraint_mode, double current_iteration, double total_iterations) {
+void IKBoneSegment3D::_set_optimal_rotation(const Ref<IKBone3D> &p_for_bone, PackedVector3Array *r_htip, PackedVector3Array *r_htarget, Vector<ik_real_t> *r_weights, ik_real_t p_cos_half_damp, bool p_translate, bool p_constraint_mode) {
 	ERR_FAIL_NULL(p_for_bone);
 	ERR_FAIL_NULL(r_htip);
 	ERR_FAIL_NULL(r_htarget);
 	ERR_FAIL_NULL(r_weights);
 
-	_update_target_headings(p_for_bone, &heading_weights, &target_headings);
+	// Trial and commit: the snapshot is the bone's local pose, and the descendants follow it rigidly on restore.
+	const bool stabilizing = default_stabilizing_pass_count > 0;
 	Transform3D prev_transform = p_for_bone->get_pose();
-	bool got_closer = true;
-	double bone_damp = p_for_bone->get_cos_half_dampen();
+	Basis prev_global_basis;
+	if (stabilizing) {
+		prev_global_basis = p_for_bone->get_global_pose().basis;
+	}
+	// A bone that only rotates keeps its origin, so its trial can be scored by rotating the tip headings it started from.
+	const bool score_from_headings = !p_translate;
+	_update_tip_headings(p_for_bone, r_htip);
+	ik_real_t start_deviation = 0.0;
+	if (stabilizing) {
+		start_deviation = _get_manual_msd(*r_htip, *r_htarget, *r_weights);
+	}
+	ik_real_t cos_half_damp = (p_cos_half_damp != -1.0) ? p_cos_half_damp : ik_real_t(p_for_bone->get_cos_half_dampen());
+	Quaternion rotation;
+	Vector3 translation;
+	if (!p_constraint_mode) {
+		Quaternion optimal_rotation;
+		if (single_heading) {
+			// A lone translation-only effector: the superposition of one heading is a pure translation for the root, or the shortest arc otherwise.
+			if (p_translate) {
+				translation = (*r_htarget)[0] - (*r_htip)[0];
+			} else {
+				optimal_rotation = QCP::get_shortest_arc((*r_htip)[0], (*r_htarget)[0]);
+			}
+		} else {
+			QCP qcp = QCP(evec_prec);
+			qcp.set_inner_product_kernel(qcp_inner_product_kernel);
+			optimal_rotation = qcp.weighted_superpose(*r_htip, *r_htarget, *r_weights, p_translate);
+			translation = qcp.get_translation();
+		}
+		rotation = clamp_to_cos_half_angle(optimal_rotation, cos_half_damp);
+	}
 	int i = 0;
 	do {
-		_update_tip_headings(p_for_bone, &tip_headings);
 		if (!p_constraint_mode) {
-			QCP qcp = QCP(evec_prec);
-			Basis rotation = qcp.weighted_superpose(*r_htip, *r_htarget, *r_weights, p_translate);
-			Vector3 translation = qcp.get_translation();
-			double dampening = (p_dampening != -1.0) ? p_dampening : bone_damp;
-			rotation = clamp_to_cos_half_angle(rotation.get_rotation_quaternion(), cos(dampening / 2.0));
-			if (current_iteration == 0) {
-				current_iteration = 0.0001;
-			}
-			rotation = rotation.slerp(p_for_bone->get_global_pose().basis, static_cast<double>(total_iterations) / current_iteration);
-			p_for_bone->get_ik_transform()->rotate_local_with_global(rotation);
+			p_for_bone->get_ik_transform()->rotate_local_with_global(Basis(rotation));
 			Transform3D result = Transform3D(p_for_bone->get_global_pose().basis, p_for_bone->get_global_pose().origin + translation);
 			p_for_bone->set_global_pose(result);
 		}
-		bool is_parent_valid = p_for_bone->get_parent().is_valid();
-		if (is_parent_valid && p_for_bone->is_orientationally_constrained()) {
-			p_for_bone->get_constraint()->snap_to_orientation_limit(p_for_bone->get_bone_direction_transform(), p_for_bone->get_ik_transform(), p_for_bone->get_constraint_orientation_transform(), bone_damp, p_for_bone->get_cos_half_dampen());
-		}
-		if (is_parent_valid && p_for_bone->is_axially_constrained()) {
-			p_for_bone->get_constraint()->set_snap_to_twist_limit(p_for_bone->get_bone_direction_transform(), p_for_bone->get_ik_transform(), p_for_bone->get_constraint_twist_transform(), bone_damp, p_for_bone->get_cos_half_dampen());
+		_apply_constraints(p_for_bone);
+		if (!stabilizing) {
+			break;
 		}
-		if (default_stabilizing_pass_count > 0) {
-			_update_tip_headings(p_for_bone, &tip_headings_uniform);
-			double current_msd = _get_manual_msd(tip_headings_uniform, target_headings, heading_weights);
-			if (current_msd <= previous_deviation * 1.0001) {
-				previous_deviation = current_msd;
-				got_closer = true;
-				break;
-			} else {
-				got_closer = false;
-				p_for_bone->set_pose(prev_transform);
+		if (score_from_headings) {
+			const Basis delta = p_for_bone->get_global_pose().basis * prev_global_basis.inverse();
+			const Vector3 *tip_heading = r_htip->ptr();
+			Vector3 *trial_heading = tip_headings_uniform.ptrw();
+			for (int32_t heading_i = 0; heading_i < tip_headings_uniform.size(); heading_i++) {
+				trial_heading[heading_i] = delta.xform(tip_heading[heading_i]);
 			}
+		} else {
+			_update_tip_headings(p_for_bone, &tip_headings_uniform);
+		}
+		ik_real_t current_msd = _get_manual_msd(tip_headings_uniform, *r_htarget, *r_weights);
+		if (current_msd <= start_deviation) {
+			previous_deviation = current_msd;
+			return;
 		}
+		// A rejected trial restores the exact pose it started from, so the superposition still holds; retry half the step.
+		p_for_bone->set_pose(prev_transform);
+		rotation = Quaternion().slerp(rotation, 0.5);
+		translation *= 0.5;
 		i++;
-	} while (i < default_stabilizing_pass_count && !got_closer);
+	} while (i < default_stabilizing_pass_count);
+	if (stabilizing) {
+		// Every trial was worse, so the bone keeps the pose it started from.
+		previous_deviation = start_deviation;
+	}
+}
 
-	if (root == p_for_bone) {
-		previous_deviation = INFINITY;
+void IKBoneSegment3D::_apply_constraints(const Ref<IKBone3D> &p_for_bone) {
+	if (p_for_bone->get_parent().is_null()) {
+		return;
+	}
+	Ref<IKKusudama3D> constraint = p_for_bone->get_constraint();
+	if (constraint.is_null()) {
+		return;
 	}
+	constraint->snap_to_limits(p_for_bone->get_bone_direction_transform(), p_for_bone->get_ik_transform(), p_for_bone->get_constraint_orientation_transform(), p_for_bone->get_constraint_twist_transform());
 }
 
-void IKBoneSegment3D::_update_target_headings(Ref<IKBone3D> p_for_bone, Vector<double> *r_weights, PackedVector3Array *r_target_headings) {
+void IKBoneSegment3D::_update_target_headings(const Ref<IKBone3D> &p_for_bone, Vector<ik_real_t> *r_weights, PackedVector3Array *r_target_headings) {
 	ERR_FAIL_NULL(p_for_bone);
 	ERR_FAIL_NULL(r_weights);
 	ERR_FAIL_NULL(r_target_headings);
 	int32_t last_index = 0;
 	for (int32_t effector_i = 0; effector_i < effector_list.size(); effector_i++) {
-		Ref<IKEffector3D> effector = effector_list[effector_i];
+		const Ref<IKEffector3D> &effector = effector_list[effector_i];
 		if (effector.is_null()) {
 			continue;
 		}
@@ -194,12 +230,12 @@ void IKBoneSegment3D::_update_target_headings(Ref<IKBone3D> p_for_bone, Vector<d
 	}
 }
 
-void IKBoneSegment3D::_update_tip_headings(Ref<IKBone3D> p_for_bone, PackedVector3Array *r_heading_tip) {
+void IKBoneSegment3D::_update_tip_headings(const Ref<IKBone3D> &p_for_bone, PackedVector3Array *r_heading_tip) {
 	ERR_FAIL_NULL(r_heading_tip);
 	ERR_FAIL_NULL(p_for_bone);
 	int32_t last_index = 0;
 	for (int32_t effector_i = 0; effector_i < effector_list.size(); effector_i++) {
-		Ref<IKEffector3D> effector = effector_list[effector_i];
+		const Ref<IKEffector3D> &effector = effector_list[effector_i];
 		if (effector.is_null()) {
 			continue;
 		}
@@ -207,35 +243,411 @@ void IKBoneSegment3D::_update_tip_headings(Ref<IKBone3D> p_for_bone, PackedVecto
 	}
 }
 
-void IKBoneSegment3D::segment_solver(const Vector<float> &p_damp, float p_default_damp, bool p_constraint_mode, int32_t p_current_iteration, int32_t p_total_iteration) {
-	for (Ref<IKBoneSegment3D> child : child_segments) {
+void IKBoneSegment3D::segment_solver(const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp, bool p_constraint_mode, int32_t p_current_iteration, int32_t p_total_iteration) {
+	for (const Ref<IKBoneSegment3D> &child : child_segments) {
 		if (child.is_null()) {
 			continue;
 		}
-		child->segment_solver(p_damp, p_default_damp, p_constraint_mode, p_current_iteration, p_total_iteration);
+		child->segment_solver(p_cos_half_damp, p_default_cos_half_damp, p_constraint_mode, p_current_iteration, p_total_iteration);
+	}
+	if (solver_engine == SOLVER_ENGINE_ANALYTIC) {
+		_analytic_solver(p_cos_half_damp, p_default_cos_half_damp, p_constraint_mode);
+		return;
+	}
+	if (solver_engine == SOLVER_ENGINE_FABRIK) {
+		_fabrik_solver(p_cos_half_damp, p_default_cos_half_damp, p_constraint_mode);
+		return;
 	}
 	bool is_translate = parent_segment.is_null();
 	if (is_translate) {
-		Vector<float> damp = p_damp;
-		damp.fill(Math_PI);
-		_qcp_solver(damp, Math_PI, is_translate, p_constraint_mode, p_current_iteration, p_total_iteration);
+		// The root segment is undamped. A damp of pi gives cos(pi / 2) = 0, which never clamps, so no per-bone table is needed.
+		_qcp_solver(Vector<ik_real_t>(), 0.0, is_translate, p_constraint_mode);
+		return;
+	}
+	_qcp_solver(p_cos_half_damp, p_default_cos_half_damp, is_translate, p_constraint_mode);
+}
+
+void IKBoneSegment3D::solve_bone(const Ref<IKBone3D> &p_for_bone, ik_real_t p_cos_half_damp, bool p_constraint_mode) {
+	ERR_FAIL_NULL(p_for_bone);
+	ERR_FAIL_COND(!bones.has(p_for_bone));
+	_update_optimal_rotation(p_for_bone, p_cos_half_damp, parent_segment.is_null() && p_for_bone == root, p_constraint_mode);
+}
+
+ik_real_t IKBoneSegment3D::get_bone_deviation(const Ref<IKBone3D> &p_for_bone) {
+	ERR_FAIL_NULL_V(p_for_bone, INFINITY);
+	_update_target_headings(p_for_bone, &heading_weights, &target_headings);
+	_update_tip_headings(p_for_bone, &tip_headings_uniform);
+	return _get_manual_msd(tip_headings_uniform, target_headings, heading_weights);
+}
+
+void IKBoneSegment3D::update_solver_engines() {
+	for (const Ref<IKBoneSegment3D> &child : child_segments) {
+		if (child.is_null()) {
+			continue;
+		}
+		child->update_solver_engines();
+	}
+	_select_solver_engine();
+}
+
+IKBoneSegment3D::SolverEngine IKBoneSegment3D::get_solver_engine() const {
+	return solver_engine;
+}
+
+bool IKBoneSegment3D::_has_single_tip_effector() const {
+	return effector_list.size() == 1 && tip->is_pinned() && effector_list[0] == tip->get_pin();
+}
+
+bool IKBoneSegment3D::_is_unconstrained() const {
+	for (const Ref<IKBone3D> &bone : bones) {
+		if (bone->get_constraint().is_valid()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void IKBoneSegment3D::_select_solver_engine() {
+	// The root segment also translates the rig, which only the QCP engine does.
+	solver_engine = SOLVER_ENGINE_QCP;
+	if (parent_segment.is_null() || !_has_single_tip_effector()) {
+		return;
+	}
+	if (analytic_short_chains && (bones.size() == 3 || bones.size() == 4)) {
+		solver_engine = SOLVER_ENGINE_ANALYTIC;
+	} else if (fabrik_unconstrained_chains && bones.size() >= 2 && _is_unconstrained()) {
+		solver_engine = SOLVER_ENGINE_FABRIK;
+	}
+}
+
+static ik_real_t _get_cos_half_damp(const Ref<IKBone3D> &p_bone, const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp) {
+	BoneId bone_id = p_bone->get_bone_id();
+	if (bone_id >= 0 && bone_id < p_cos_half_damp.size()) {
+		return p_cos_half_damp[bone_id];
+	}
+	return p_default_cos_half_damp;
+}
+
+void IKBoneSegment3D::build_coarse_skeleton(IKNode3DPool *p_pool) {
+	coarse_bones.clear();
+	coarse_origin = p_pool ? p_pool->acquire() : Ref<IKNode3D>(memnew(IKNode3D));
+	// The root segment also translates the rig, which is left to the full iterations, so its children hang from a fixed origin.
+	for (const Ref<IKBoneSegment3D> &child : child_segments) {
+		child->_add_coarse_bones(coarse_bones, coarse_origin, p_pool);
+	}
+	// Effectors are looked up once here; their tips are the ends of the virtual bones of the pinned segments.
+	HashMap<const IKBone3D *, int32_t> end_of_tip;
+	for (uint32_t coarse_i = 0; coarse_i < coarse_bones.size(); coarse_i++) {
+		end_of_tip.insert(coarse_bones[coarse_i].segment->tip.ptr(), coarse_i);
+	}
+	for (CoarseBone &coarse_bone : coarse_bones) {
+		const Vector<Ref<IKEffector3D>> &effectors = coarse_bone.segment->effector_list;
+		coarse_bone.effector_ends.resize(effectors.size());
+		for (int32_t effector_i = 0; effector_i < effectors.size(); effector_i++) {
+			const int32_t *end = effectors[effector_i].is_valid() ? end_of_tip.getptr(effectors[effector_i]->for_bone.ptr()) : nullptr;
+			coarse_bone.effector_ends[effector_i] = end ? *end : -1;
+		}
+		coarse_bone.tip_headings.resize(coarse_bone.segment->target_headings.size());
+		coarse_bone.target_headings.resize(coarse_bone.segment->target_headings.size());
+	}
+}
+
+void IKBoneSegment3D::_add_coarse_bones(LocalVector<CoarseBone> &r_coarse_bones, const Ref<IKNode3D> &p_parent, IKNode3DPool *p_pool) {
+	if (effector_list.is_empty()) {
+		return;
+	}
+	CoarseBone coarse_bone;
+	coarse_bone.segment = Ref<IKBoneSegment3D>(this);
+	coarse_bone.pivot = p_pool ? p_pool->acquire() : Ref<IKNode3D>(memnew(IKNode3D));
+	coarse_bone.end = p_pool ? p_pool->acquire() : Ref<IKNode3D>(memnew(IKNode3D));
+	coarse_bone.pivot->set_parent(p_parent);
+	coarse_bone.end->set_parent(coarse_bone.pivot);
+	r_coarse_bones.push_back(coarse_bone);
+	for (const Ref<IKBoneSegment3D> &child : child_segments) {
+		child->_add_coarse_bones(r_coarse_bones, coarse_bone.end, p_pool);
+	}
+}
+
+void IKBoneSegment3D::coarse_solver(const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp, int32_t p_iterations) {
+	if (coarse_bones.is_empty() || p_iterations <= 0) {
 		return;
 	}
-	_qcp_solver(p_damp, p_default_damp, is_translate, p_constraint_mode, p_current_iteration, p_total_iteration);
+	// Place the reduced skeleton on the current pose. A virtual bone may turn as far as all the bones of its chain together.
+	for (CoarseBone &coarse_bone : coarse_bones) {
+		const IKBoneSegment3D *segment = coarse_bone.segment.ptr();
+		coarse_bone.pivot->set_global_transform(segment->root->get_bone_direction_global_pose());
+		coarse_bone.end->set_global_transform(segment->tip->get_bone_direction_global_pose());
+		ik_real_t half_angle = 0.0;
+		for (const Ref<IKBone3D> &bone : segment->bones) {
+			half_angle += Math::acos(CLAMP(_get_cos_half_damp(bone, p_cos_half_damp, p_default_cos_half_damp), ik_real_t(-1.0), ik_real_t(1.0)));
+		}
+		coarse_bone.cos_half_damp = half_angle < Math_PI / 2.0 ? Math::cos(half_angle) : ik_real_t(0.0);
+	}
+	// Virtual bones are solved from the tips to the root, the same order segment_solver() takes through the segments.
+	for (int32_t iteration_i = 0; iteration_i < p_iterations; iteration_i++) {
+		for (uint32_t coarse_i = coarse_bones.size(); coarse_i-- > 0;) {
+			_solve_coarse_bone(coarse_bones[coarse_i]);
+		}
+	}
+	// Parents first, so every chain is bent from where its parent chain left its root.
+	for (const CoarseBone &coarse_bone : coarse_bones) {
+		_distribute_coarse_bone(coarse_bone, p_cos_half_damp, p_default_cos_half_damp);
+	}
+}
+
+void IKBoneSegment3D::_solve_coarse_bone(CoarseBone &r_coarse_bone) {
+	IKBoneSegment3D *segment = r_coarse_bone.segment.ptr();
+	const Vector3 origin = r_coarse_bone.pivot->get_global_transform().origin;
+	int32_t tip_index = 0;
+	int32_t target_index = 0;
+	for (int32_t effector_i = 0; effector_i < segment->effector_list.size(); effector_i++) {
+		const Ref<IKEffector3D> &effector = segment->effector_list[effector_i];
+		const int32_t end_i = r_coarse_bone.effector_ends[effector_i];
+		if (effector.is_null() || end_i == -1) {
+			continue;
+		}
+		tip_index = effector->update_effector_tip_headings(&r_coarse_bone.tip_headings, tip_index, coarse_bones[end_i].end->get_global_transform(), origin);
+		target_index = effector->update_effector_target_headings(&r_coarse_bone.target_headings, target_index, origin, &segment->heading_weights);
+	}
+	Quaternion optimal_rotation;
+	if (segment->single_heading) {
+		optimal_rotation = QCP::get_shortest_arc(r_coarse_bone.tip_headings[0], r_coarse_bone.target_headings[0]);
+	} else {
+		QCP qcp = QCP(evec_prec);
+		qcp.set_inner_product_kernel(segment->qcp_inner_product_kernel);
+		optimal_rotation = qcp.weighted_superpose(r_coarse_bone.tip_headings, r_coarse_bone.target_headings, segment->heading_weights, false);
+	}
+	r_coarse_bone.pivot->rotate_local_with_global(Basis(clamp_to_cos_half_angle(optimal_rotation, r_coarse_bone.cos_half_damp)), true);
+}
+
+void IKBoneSegment3D::_distribute_coarse_bone(const CoarseBone &p_coarse_bone, const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp) {
+	IKBoneSegment3D *segment = p_coarse_bone.segment.ptr();
+	const Transform3D goal = p_coarse_bone.end->get_global_transform();
+	const Ref<IKBone3D> &chain_tip = segment->tip;
+	// bones is ordered from the tip to the root. Every bone above the tip swings an equal share of what the chain still misses,
+	// so the chain curls evenly instead of kinking at its root, and the last of them puts the tip on the goal.
+	for (int32_t bone_i = segment->bones.size() - 1; bone_i > 0; bone_i--) {
+		const Ref<IKBone3D> &bone = segment->bones[bone_i];
+		const Vector3 pivot = bone->get_bone_direction_global_pose().origin;
+		const Quaternion swing = QCP::get_shortest_arc(chain_tip->get_bone_direction_global_pose().origin - pivot, goal.origin - pivot);
+		bone->get_ik_transform()->rotate_local_with_global(Basis(clamp_to_cos_half_angle(Quaternion().slerp(swing, ik_real_t(1.0) / bone_i), _get_cos_half_damp(bone, p_cos_half_damp, p_default_cos_half_damp))), true);
+		segment->_apply_constraints(bone);
+	}
+	// The tip then turns to the goal orientation, which carries the child chains to where the reduced solve left them.
+	const Basis tip_basis = chain_tip->get_bone_direction_global_pose().basis.orthonormalized();
+	const Quaternion turn = (goal.basis.orthonormalized() * tip_basis.inverse()).get_rotation_quaternion();
+	chain_tip->get_ik_transform()->rotate_local_with_global(Basis(clamp_to_cos_half_angle(turn, _get_cos_half_damp(chain_tip, p_cos_half_damp, p_default_cos_half_damp))), true);
+	segment->_apply_constraints(chain_tip);
+}
+
+Vector3 IKBoneSegment3D::_get_bend_axis(const Ref<IKBone3D> &p_bend_bone, const Ref<IKEffector3D> &p_effector, const Vector3 &p_to_root, const Vector3 &p_to_end) {
+	if (p_effector->has_pole) {
+		// Bend so the joint moves toward the pole: rotating to_root about this axis swings the far link away from it.
+		Vector3 pole_axis = (p_effector->pole_relative_to_skeleton_origin - p_bend_bone->get_global_pose().origin).cross(p_to_root);
+		if (!pole_axis.is_zero_approx()) {
+			return pole_axis.normalized();
+		}
+	}
+	Vector3 bend_axis = p_to_root.cross(p_to_end);
+	if (!bend_axis.is_zero_approx()) {
+		return bend_axis.normalized();
+	}
+	// The chain is straight or folded, so the current pose defines no bend plane. Bend around the joint's own x axis, like a knee or an elbow.
+	Vector3 fallback_axis = p_bend_bone->get_bone_direction_global_pose().basis.get_column(Vector3::AXIS_X);
+	fallback_axis -= p_to_root * fallback_axis.dot(p_to_root);
+	if (fallback_axis.is_zero_approx()) {
+		Vector3 reference = Math::abs(p_to_root.x) < Math::abs(p_to_root.y) ? Vector3(1, 0, 0) : Vector3(0, 1, 0);
+		fallback_axis = p_to_root.cross(reference);
+	}
+	return fallback_axis.normalized();
+}
+
+void IKBoneSegment3D::_analytic_solver(const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp, bool p_constraint_mode) {
+	// Two and three bone chains ending in a single effector: bend the joint below the segment root with the law of cosines,
+	// then swing the segment root onto the target. For three bones the two distal links move rigidly, keeping the current bend between them.
+	const Ref<IKBone3D> &upper = root;
+	const Ref<IKBone3D> &lower = bones[bones.size() - 2];
+	Ref<IKEffector3D> effector = tip->get_pin();
+	if (!p_constraint_mode) {
+		const Transform3D &target = effector->target_relative_to_skeleton_origin;
+		Vector3 upper_origin = upper->get_global_pose().origin;
+		Vector3 lower_origin = lower->get_global_pose().origin;
+		Vector3 end_origin = tip->get_global_pose().origin;
+		ik_real_t upper_length = upper_origin.distance_to(lower_origin);
+		ik_real_t lower_length = lower_origin.distance_to(end_origin);
+		if (Math::is_zero_approx(upper_length) || Math::is_zero_approx(lower_length)) {
+			// A zero length link has no bend plane; the iterative solver still moves the chain and applies its constraints.
+			_qcp_solver(p_cos_half_damp, p_default_cos_half_damp, parent_segment.is_null(), p_constraint_mode);
+			return;
+		}
+
+		ik_real_t reach = upper_length + lower_length;
+		ik_real_t slack = reach * ik_real_t(1e-4);
+		ik_real_t target_distance = CLAMP(ik_real_t(upper_origin.distance_to(target.origin)), MAX(Math::abs(upper_length - lower_length), slack), reach - slack);
+		ik_real_t bend_cosine = (upper_length * upper_length + lower_length * lower_length - target_distance * target_distance) / (2.0 * upper_length * lower_length);
+		ik_real_t bend_angle = Math::acos(CLAMP(bend_cosine, ik_real_t(-1.0), ik_real_t(1.0)));
+
+		Vector3 to_root = (upper_origin - lower_origin).normalized();
+		Vector3 to_end = (end_origin - lower_origin).normalized();
+		Vector3 bend_axis = _get_bend_axis(lower, effector, to_root, to_end);
+		Vector3 bent_to_end = Quaternion(bend_axis, bend_angle).xform(to_root);
+		Quaternion bend = clamp_to_cos_half_angle(QCP::get_shortest_arc(to_end, bent_to_end), _get_cos_half_damp(lower, p_cos_half_damp, p_default_cos_half_damp));
+		lower->get_ik_transform()->rotate_local_with_global(bend, true);
+
+		end_origin = tip->get_global_pose().origin;
+		Vector3 to_target = target.origin - upper_origin;
+		Quaternion swing = QCP::get_shortest_arc(end_origin - upper_origin, to_target);
+		if (effector->has_pole && !to_target.is_zero_approx()) {
+			// The shortest arc keeps whatever roll the chain had. Roll it about the root to target line until the joint faces the pole.
+			Vector3 axis = to_target.normalized();
+			Vector3 joint = swing.xform(lower_origin - upper_origin);
+			Vector3 pole = effector->pole_relative_to_skeleton_origin - upper_origin;
+			joint -= axis * axis.dot(joint);
+			pole -= axis * axis.dot(pole);
+			if (!joint.is_zero_approx() && !pole.is_zero_approx()) {
+				swing = Quaternion(axis, Math::atan2(axis.dot(joint.cross(pole)), joint.dot(pole))) * swing;
+			}
+		}
+		swing = clamp_to_cos_half_angle(swing, _get_cos_half_damp(upper, p_cos_half_damp, p_default_cos_half_damp));
+		upper->get_ik_transform()->rotate_local_with_global(swing, true);
+
+		if (!effector->is_following_translation_only()) {
+			Basis tip_basis = tip->get_bone_direction_global_pose().basis.orthonormalized();
+			Quaternion align = (target.basis.orthonormalized() * tip_basis.inverse()).get_rotation_quaternion();
+			align = clamp_to_cos_half_angle(align, _get_cos_half_damp(tip, p_cos_half_damp, p_default_cos_half_damp));
+			tip->get_ik_transform()->rotate_local_with_global(align, true);
+		}
+	}
+	for (int32_t bone_i = bones.size(); bone_i-- > 0;) {
+		_apply_constraints(bones[bone_i]);
+	}
+}
+
+void IKBoneSegment3D::_fabrik_solver(const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp, bool p_constraint_mode) {
+	// Unconstrained chains ending in a single effector: one backward and one forward reaching pass over the joint origins,
+	// then every bone swings from the root down onto the new position of its child. The solver's outer iterations repeat the passes.
+	if (p_constraint_mode) {
+		return;
+	}
+	Ref<IKEffector3D> effector = tip->get_pin();
+	const Transform3D &target = effector->target_relative_to_skeleton_origin;
+	// bones is ordered from the tip to the root, so joint 0 is the tip and the last joint is the segment root.
+	const int32_t joint_count = bones.size();
+	fabrik_joints.resize(joint_count);
+	fabrik_lengths.resize(joint_count - 1);
+	for (int32_t joint_i = 0; joint_i < joint_count; joint_i++) {
+		fabrik_joints[joint_i] = bones[joint_i]->get_global_pose().origin;
+	}
+	for (int32_t joint_i = 0; joint_i < joint_count - 1; joint_i++) {
+		fabrik_lengths[joint_i] = fabrik_joints[joint_i].distance_to(fabrik_joints[joint_i + 1]);
+	}
+	const Vector3 root_origin = fabrik_joints[joint_count - 1];
+
+	fabrik_joints[0] = target.origin;
+	for (int32_t joint_i = 1; joint_i < joint_count; joint_i++) {
+		Vector3 direction = (fabrik_joints[joint_i] - fabrik_joints[joint_i - 1]).normalized();
+		fabrik_joints[joint_i] = fabrik_joints[joint_i - 1] + direction * fabrik_lengths[joint_i - 1];
+	}
+	fabrik_joints[joint_count - 1] = root_origin;
+	for (int32_t joint_i = joint_count - 1; joint_i-- > 0;) {
+		Vector3 direction = (fabrik_joints[joint_i] - fabrik_joints[joint_i + 1]).normalized();
+		fabrik_joints[joint_i] = fabrik_joints[joint_i + 1] + direction * fabrik_lengths[joint_i];
+	}
+
+	for (int32_t joint_i = joint_count - 1; joint_i > 0; joint_i--) {
+		const Ref<IKBone3D> &bone = bones[joint_i];
+		Vector3 origin = bone->get_global_pose().origin;
+		Vector3 current = bones[joint_i - 1]->get_global_pose().origin - origin;
+		Vector3 desired = fabrik_joints[joint_i - 1] - origin;
+		Quaternion swing = clamp_to_cos_half_angle(QCP::get_shortest_arc(current, desired), _get_cos_half_damp(bone, p_cos_half_damp, p_default_cos_half_damp));
+		bone->get_ik_transform()->rotate_local_with_global(swing, true);
+	}
+
+	if (!effector->is_following_translation_only()) {
+		Basis tip_basis = tip->get_bone_direction_global_pose().basis.orthonormalized();
+		Quaternion align = (target.basis.orthonormalized() * tip_basis.inverse()).get_rotation_quaternion();
+		align = clamp_to_cos_half_angle(align, _get_cos_half_damp(tip, p_cos_half_damp, p_default_cos_half_damp));
+		tip->get_ik_transform()->rotate_local_with_global(align, true);
+	}
+}
+
+// Segments shorter than this solve their Jacobi step inline; the group task overhead would outweigh the parallel QCP solves.
+static const int32_t JACOBI_PARALLEL_BONE_COUNT = 8;
+
+void IKBoneSegment3D::_solve_jacobi_bone(uint32_t p_bone_index, void *p_userdata) {
+	const Ref<IKBone3D> &bone = bones[p_bone_index];
+	JacobiBone &jacobi_bone = jacobi_bones[p_bone_index];
+	_update_target_headings(bone, &heading_weights, &jacobi_bone.target_headings);
+	_update_tip_headings(bone, &jacobi_bone.tip_headings);
+	Quaternion optimal_rotation;
+	Vector3 translation;
+	if (single_heading) {
+		if (jacobi_translate) {
+			translation = jacobi_bone.target_headings[0] - jacobi_bone.tip_headings[0];
+		} else {
+			optimal_rotation = QCP::get_shortest_arc(jacobi_bone.tip_headings[0], jacobi_bone.target_headings[0]);
+		}
+	} else {
+		QCP qcp = QCP(evec_prec);
+		qcp.set_inner_product_kernel(qcp_inner_product_kernel);
+		optimal_rotation = qcp.weighted_superpose(jacobi_bone.tip_headings, jacobi_bone.target_headings, heading_weights, jacobi_translate);
+		translation = qcp.get_translation();
+	}
+	jacobi_bone.rotation = clamp_to_cos_half_angle(Quaternion().slerp(optimal_rotation, jacobi_relaxation * jacobi_share), jacobi_bone.cos_half_damp);
+	jacobi_bone.translation = translation * jacobi_relaxation;
 }
 
-void IKBoneSegment3D::_qcp_solver(const Vector<float> &p_damp, float p_default_damp, bool p_translate, bool p_constraint_mode, int32_t p_current_iteration, int32_t p_total_iterations) {
-	for (Ref<IKBone3D> current_bone : bones) {
-		float damp = p_default_damp;
-		bool is_valid_access = !(unlikely((p_damp.size()) < 0 || (current_bone->get_bone_id()) >= (p_damp.size())));
-		if (is_valid_access) {
-			damp = p_damp[current_bone->get_bone_id()];
+void IKBoneSegment3D::_jacobi_solver(const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp, bool p_translate) {
+	// Every bone solves against the same frozen pose, then all the relaxed rotations are applied from the tip to the root.
+	const int32_t bone_count = bones.size();
+	jacobi_bones.resize(bone_count);
+	for (int32_t bone_i = 0; bone_i < bone_count; bone_i++) {
+		JacobiBone &jacobi_bone = jacobi_bones[bone_i];
+		jacobi_bone.cos_half_damp = _get_cos_half_damp(bones[bone_i], p_cos_half_damp, p_default_cos_half_damp);
+		jacobi_bone.tip_headings.resize(tip_headings.size());
+		jacobi_bone.target_headings.resize(target_headings.size());
+		// Resolve the lazily cached global transforms here, so the solves below only read them.
+		bones[bone_i]->get_bone_direction_global_pose();
+	}
+	for (const Ref<IKEffector3D> &effector : effector_list) {
+		if (effector.is_valid()) {
+			effector->for_bone->get_bone_direction_global_pose();
 		}
-		bool is_non_default_damp = p_default_damp < damp;
-		if (is_non_default_damp) {
-			damp = p_default_damp;
+	}
+	jacobi_translate = p_translate;
+	// Each optimal rotation alone would close the whole error, so bones applying theirs at once overshoot by the bone count.
+	jacobi_share = ik_real_t(1.0) / bone_count;
+	// Solves that already run on a worker thread, like background and reachability solves, stay inline rather than wait on a nested group.
+	if (bone_count >= JACOBI_PARALLEL_BONE_COUNT && Thread::is_main_thread()) {
+		WorkerThreadPool::GroupID group = WorkerThreadPool::get_singleton()->add_template_group_task(this, &IKBoneSegment3D::_solve_jacobi_bone, (void *)nullptr, bone_count, -1, true, "ManyBoneIK3D Jacobi iteration");
+		WorkerThreadPool::get_singleton()->wait_for_group_task_completion(group);
+	} else {
+		for (int32_t bone_i = 0; bone_i < bone_count; bone_i++) {
+			_solve_jacobi_bone(bone_i, nullptr);
 		}
-		_update_optimal_rotation(current_bone, damp, p_translate, p_constraint_mode, p_current_iteration, p_total_iterations);
+	}
+	for (int32_t bone_i = 0; bone_i < bone_count; bone_i++) {
+		const Ref<IKBone3D> &bone = bones[bone_i];
+		const JacobiBone &jacobi_bone = jacobi_bones[bone_i];
+		bone->get_ik_transform()->rotate_local_with_global(jacobi_bone.rotation, true);
+		// Every bone found roughly the same translation against the frozen pose, so only the segment root applies it.
+		if (p_translate && bone == root) {
+			Transform3D global_pose = bone->get_global_pose();
+			bone->set_global_pose(Transform3D(global_pose.basis, global_pose.origin + jacobi_bone.translation));
+		}
+		_apply_constraints(bone);
+	}
+}
+
+void IKBoneSegment3D::_qcp_solver(const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp, bool p_translate, bool p_constraint_mode) {
+	// Stabilization trials score and roll back one bone at a time, which only the sequential scheme does.
+	if (jacobi_iterations && !p_constraint_mode && default_stabilizing_pass_count == 0) {
+		_jacobi_solver(p_cos_half_damp, p_default_cos_half_damp, p_translate);
+		return;
+	}
+	for (const Ref<IKBone3D> &current_bone : bones) {
+		// Only the segment root translates; moving a bone further in would stretch it away from its parent.
+		_update_optimal_rotation(current_bone, _get_cos_half_damp(current_bone, p_cos_half_damp, p_default_cos_half_damp), p_translate && current_bone == root, p_constraint_mode);
 	}
 }
 
@@ -261,6 +673,18 @@ IKBoneSegment3D::IKBoneSegment3D(Skeleton3D *p_skeleton, StringName p_root_bone_
 		root->set_parent(p_parent->get_tip());
 	}
 	default_stabilizing_pass_count = p_stabilizing_pass_count;
+	analytic_short_chains = p_many_bone_ik->get_analytic_short_chains();
+	fabrik_unconstrained_chains = p_many_bone_ik->get_fabrik_unconstrained_chains();
+	jacobi_iterations = p_many_bone_ik->get_iteration_scheme() == ManyBoneIK3D::ITERATION_SCHEME_JACOBI;
+	jacobi_relaxation = p_many_bone_ik->get_jacobi_relaxation();
+}
+
+ik_real_t IKBoneSegment3D::get_previous_deviation() const {
+	return previous_deviation;
+}
+
+void IKBoneSegment3D::set_previous_deviation(ik_real_t p_previous_deviation) {
+	previous_deviation = p_previous_deviation;
 }
 
 void IKBoneSegment3D::_enable_pinned_descendants() {
@@ -279,12 +703,12 @@ Ref<IKBone3D> IKBoneSegment3D::get_ik_bone(BoneId p_bone) const {
 }
 
 void IKBoneSegment3D::create_headings_arrays() {
-	Vector<Vector<double>> penalty_array;
+	Vector<Vector<ik_real_t>> penalty_array;
 	Vector<Ref<IKBone3D>> new_pinned_bones;
 	recursive_create_penalty_array(this, penalty_array, new_pinned_bones, 1.0);
 	pinned_bones.resize(new_pinned_bones.size());
 	int32_t total_headings = 0;
-	for (const Vector<double> &current_penalty_array : penalty_array) {
+	for (const Vector<ik_real_t> &current_penalty_array : penalty_array) {
 		total_headings += current_penalty_array.size();
 	}
 	for (int32_t bone_i = 0; bone_i < new_pinned_bones.size(); bone_i++) {
@@ -294,9 +718,11 @@ void IKBoneSegment3D::create_headings_arrays() {
 	tip_headings.resize(total_headings);
 	tip_headings_uniform.resize(total_headings);
 	heading_weights.resize(total_headings);
+	qcp_inner_product_kernel = QCP::get_inner_product_kernel(total_headings);
+	single_heading = total_headings == 1;
 	int currentHeading = 0;
-	for (const Vector<double> &current_penalty_array : penalty_array) {
-		for (double ad : current_penalty_array) {
+	for (const Vector<ik_real_t> &current_penalty_array : penalty_array) {
+		for (ik_real_t ad : current_penalty_array) {
 			heading_weights.write[currentHeading] = ad;
 			target_headings.write[currentHeading] = Vector3();
 			tip_headings.write[currentHeading] = Vector3();
@@ -306,27 +732,27 @@ void IKBoneSegment3D::create_headings_arrays() {
 	}
 }
 
-void IKBoneSegment3D::recursive_create_penalty_array(Ref<IKBoneSegment3D> p_bone_segment, Vector<Vector<double>> &r_penalty_array, Vector<Ref<IKBone3D>> &r_pinned_bones, double p_falloff) {
+void IKBoneSegment3D::recursive_create_penalty_array(Ref<IKBoneSegment3D> p_bone_segment, Vector<Vector<ik_real_t>> &r_penalty_array, Vector<Ref<IKBone3D>> &r_pinned_bones, ik_real_t p_falloff) {
 	if (p_falloff <= 0.0) {
 		return;
 	}
 
-	double current_falloff = 1.0;
+	ik_real_t current_falloff = 1.0;
 
 	if (p_bone_segment->is_pinned()) {
 		Ref<IKBone3D> current_tip = p_bone_segment->get_tip();
 		Ref<IKEffector3D> pin = current_tip->get_pin();
-		double weight = pin->get_weight();
-		Vector<double> inner_weight_array;
+		ik_real_t weight = pin->get_weight();
+		Vector<ik_real_t> inner_weight_array;
 		inner_weight_array.push_back(weight * p_falloff);
 
-		double max_pin_weight = MAX(MAX(pin->get_direction_priorities().x, pin->get_direction_priorities().y), pin->get_direction_priorities().z);
+		ik_real_t max_pin_weight = MAX(MAX(pin->get_direction_priorities().x, pin->get_direction_priorities().y), pin->get_direction_priorities().z);
 		max_pin_weight = max_pin_weight == 0.0 ? 1.0 : max_pin_weight;
 
 		for (int i = 0; i < 3; ++i) {
-			double priority = pin->get_direction_priorities()[i];
+			ik_real_t priority = pin->get_direction_priorities()[i];
 			if (priority > 0.0) {
-				double sub_target_weight = weight * (priority / max_pin_weight) * p_falloff;
+				ik_real_t sub_target_weight = weight * (priority / max_pin_weight) * p_falloff;
 				inner_weight_array.push_back(sub_target_weight);
 				inner_weight_array.push_back(sub_target_weight);
 			}
@@ -349,6 +775,21 @@ void IKBoneSegment3D::recursive_create_headings_arrays_for(Ref<IKBoneSegment3D>
 	}
 }
 
+void IKBoneSegment3D::release() {
+	for (Ref<IKBoneSegment3D> &child_segment : child_segments) {
+		child_segment->release();
+	}
+	for (KeyValue<BoneId, Ref<IKBone3D>> &entry : bone_map) {
+		entry.value->clear_links();
+	}
+	child_segments.clear();
+	parent_segment.unref();
+	root_segment.unref();
+	bone_map.clear();
+	coarse_bones.clear();
+	coarse_origin.unref();
+}
+
 void IKBoneSegment3D::generate_default_segments(Vector<Ref<IKEffectorTemplate3D>> &p_pins, BoneId p_root_bone, BoneId p_tip_bone, ManyBoneIK3D *p_many_bone_ik) {
 	Ref<IKBone3D> current_tip = root;
 	Vector<BoneId> children;
@@ -376,6 +817,12 @@ bool IKBoneSegment3D::_has_multiple_children_or_pinned(Vector<BoneId> &r_childre
 	return r_children.size() > 1 || p_current_tip->is_pinned();
 }
 
+struct SegmentRootBoneComparator {
+	_FORCE_INLINE_ bool operator()(const Ref<IKBoneSegment3D> &p_a, const Ref<IKBoneSegment3D> &p_b) const {
+		return p_a->get_root()->get_bone_id() < p_b->get_root()->get_bone_id();
+	}
+};
+
 void IKBoneSegment3D::_process_children(Vector<BoneId> &r_children, Ref<IKBone3D> p_current_tip, Vector<Ref<IKEffectorTemplate3D>> &r_pins, BoneId p_root_bone, BoneId p_tip_bone, ManyBoneIK3D *p_many_bone_ik) {
 	tip = p_current_tip;
 	Ref<IKBoneSegment3D> parent(this);
@@ -392,6 +839,10 @@ void IKBoneSegment3D::_process_children(Vector<BoneId> &r_children, Ref<IKBone3D
 			child_segments.push_back(child_segment);
 		}
 	}
+	if (p_many_bone_ik->get_deterministic()) {
+		// The effector list and the heading weights are both built by walking child_segments, so this fixes their order too.
+		child_segments.sort_custom<SegmentRootBoneComparator>();
+	}
 }
 
 Ref<IKBoneSegment3D> IKBoneSegment3D::_create_child_segment(String &p_child_name, Vector<Ref<IKEffectorTemplate3D>> &p_pins, BoneId p_root_bone, BoneId p_tip_bone, ManyBoneIK3D *p_many_bone_ik, Ref<IKBoneSegment3D> &p_parent) {
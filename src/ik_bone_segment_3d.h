@@ -34,11 +34,13 @@
 #include "ik_bone_3d.h"
 #include "ik_effector_3d.h"
 #include "ik_effector_template_3d.h"
+#include "math/ik_precision.h"
 #include "math/qcp.h"
 #include "scene/3d/skeleton_3d.h"
 
 #include "core/io/resource.h"
 #include "core/object/ref_counted.h"
+#include "core/templates/local_vector.h"
 
 class IKEffector3D;
 class IKBone3D;
@@ -46,6 +48,16 @@ class IKLimitCone3D;
 
 class IKBoneSegment3D : public Resource {
 	GDCLASS(IKBoneSegment3D, Resource);
+
+public:
+	// How segment_solver() moves the bones of this segment. Picked once per rig by update_solver_engines().
+	enum SolverEngine {
+		SOLVER_ENGINE_QCP, // Iterative weighted superposition of all effector headings, bone by bone.
+		SOLVER_ENGINE_ANALYTIC, // Closed form for two and three bone chains ending in a single effector.
+		SOLVER_ENGINE_FABRIK, // Forward and backward reaching for unconstrained chains ending in a single effector.
+	};
+
+private:
 	Ref<IKBone3D> root;
 	Ref<IKBone3D> tip;
 	Vector<Ref<IKBone3D>> bones;
@@ -57,19 +69,65 @@ class IKBoneSegment3D : public Resource {
 	PackedVector3Array target_headings;
 	PackedVector3Array tip_headings;
 	PackedVector3Array tip_headings_uniform;
-	Vector<double> heading_weights;
+	Vector<ik_real_t> heading_weights;
+	QCP::InnerProductKernel qcp_inner_product_kernel = nullptr;
+	bool single_heading = false;
+	bool analytic_short_chains = false;
+	bool fabrik_unconstrained_chains = false;
+	SolverEngine solver_engine = SOLVER_ENGINE_QCP;
+	LocalVector<Vector3> fabrik_joints;
+	LocalVector<ik_real_t> fabrik_lengths;
+	// Per-bone scratch for the Jacobi scheme. Each bone solves into its own entry, so the entries can be filled in parallel.
+	struct JacobiBone {
+		PackedVector3Array tip_headings;
+		PackedVector3Array target_headings;
+		ik_real_t cos_half_damp = 1.0;
+		Quaternion rotation;
+		Vector3 translation;
+	};
+	bool jacobi_iterations = false;
+	ik_real_t jacobi_relaxation = 1.0;
+	bool jacobi_translate = false;
+	ik_real_t jacobi_share = 1.0;
+	LocalVector<JacobiBone> jacobi_bones;
+	// The reduced skeleton of the coarse solve, held by root segments. Each child segment is one virtual bone that pivots at the
+	// segment root and carries the segment tip rigidly. Entries are ordered parents first.
+	struct CoarseBone {
+		Ref<IKBoneSegment3D> segment;
+		Ref<IKNode3D> pivot;
+		Ref<IKNode3D> end;
+		// For each effector of the segment, the index of the coarse bone whose end is that effector's tip, or -1.
+		LocalVector<int32_t> effector_ends;
+		PackedVector3Array tip_headings;
+		PackedVector3Array target_headings;
+		ik_real_t cos_half_damp = 0.0;
+	};
+	LocalVector<CoarseBone> coarse_bones;
+	Ref<IKNode3D> coarse_origin;
 	Skeleton3D *skeleton = nullptr;
 	bool pinned_descendants = false;
-	double previous_deviation = INFINITY;
+	ik_real_t previous_deviation = INFINITY;
 	int32_t default_stabilizing_pass_count = 0; // Move to the stabilizing pass to the ik solver. Set it free.
 	bool _has_pinned_descendants();
 	void _enable_pinned_descendants();
-	void _update_target_headings(Ref<IKBone3D> p_for_bone, Vector<double> *r_weights, PackedVector3Array *r_htarget);
-	void _update_tip_headings(Ref<IKBone3D> p_for_bone, PackedVector3Array *r_heading_tip);
-	void _set_optimal_rotation(Ref<IKBone3D> p_for_bone, PackedVector3Array *r_htip, PackedVector3Array *r_heading_tip, Vector<double> *r_weights, float p_dampening = -1, bool p_translate = false, bool p_constraint_mode = false, double current_iteration = 0, double total_iterations = 0);
-	void _qcp_solver(const Vector<float> &p_damp, float p_default_damp, bool p_translate, bool p_constraint_mode, int32_t p_current_iteration, int32_t p_total_iterations);
-	void _update_optimal_rotation(Ref<IKBone3D> p_for_bone, double p_damp, bool p_translate, bool p_constraint_mode, int32_t current_iteration, int32_t total_iterations);
-	float _get_manual_msd(const PackedVector3Array &r_htip, const PackedVector3Array &r_htarget, const Vector<double> &p_weights);
+	void _update_target_headings(const Ref<IKBone3D> &p_for_bone, Vector<ik_real_t> *r_weights, PackedVector3Array *r_htarget);
+	void _update_tip_headings(const Ref<IKBone3D> &p_for_bone, PackedVector3Array *r_heading_tip);
+	void _set_optimal_rotation(const Ref<IKBone3D> &p_for_bone, PackedVector3Array *r_htip, PackedVector3Array *r_heading_tip, Vector<ik_real_t> *r_weights, ik_real_t p_cos_half_damp = -1, bool p_translate = false, bool p_constraint_mode = false);
+	void _apply_constraints(const Ref<IKBone3D> &p_for_bone);
+	static Vector3 _get_bend_axis(const Ref<IKBone3D> &p_bend_bone, const Ref<IKEffector3D> &p_effector, const Vector3 &p_to_root, const Vector3 &p_to_end);
+	bool _has_single_tip_effector() const;
+	bool _is_unconstrained() const;
+	void _select_solver_engine();
+	void _analytic_solver(const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp, bool p_constraint_mode);
+	void _fabrik_solver(const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp, bool p_constraint_mode);
+	void _jacobi_solver(const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp, bool p_translate);
+	void _solve_jacobi_bone(uint32_t p_bone_index, void *p_userdata);
+	void _add_coarse_bones(LocalVector<CoarseBone> &r_coarse_bones, const Ref<IKNode3D> &p_parent, IKNode3DPool *p_pool);
+	void _solve_coarse_bone(CoarseBone &r_coarse_bone);
+	void _distribute_coarse_bone(const CoarseBone &p_coarse_bone, const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp);
+	void _qcp_solver(const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp, bool p_translate, bool p_constraint_mode);
+	void _update_optimal_rotation(const Ref<IKBone3D> &p_for_bone, ik_real_t p_cos_half_damp, bool p_translate, bool p_constraint_mode);
+	ik_real_t _get_manual_msd(const PackedVector3Array &r_htip, const PackedVector3Array &r_htarget, const Vector<ik_real_t> &p_weights);
 	HashMap<BoneId, Ref<IKBone3D>> bone_map;
 	bool _is_parent_of_tip(Ref<IKBone3D> p_current_tip, BoneId p_tip_bone);
 	bool _has_multiple_children_or_pinned(Vector<BoneId> &r_children, Ref<IKBone3D> p_current_tip);
@@ -82,17 +140,33 @@ protected:
 	static void _bind_methods();
 
 public:
-	const double evec_prec = static_cast<double>(1E-6);
-	void update_pinned_list(Vector<Vector<double>> &r_weights);
-	static Quaternion clamp_to_cos_half_angle(Quaternion p_quat, double p_cos_half_angle);
+	const ik_real_t evec_prec = static_cast<ik_real_t>(1E-6);
+	void update_pinned_list(Vector<Vector<ik_real_t>> &r_weights);
+	static Quaternion clamp_to_cos_half_angle(Quaternion p_quat, ik_real_t p_cos_half_angle);
 	static void recursive_create_headings_arrays_for(Ref<IKBoneSegment3D> p_bone_segment);
+	// Breaks the reference cycles between the segments and bones of a discarded rig so it is freed, and its transforms can go back to the pool.
+	void release();
 	void create_headings_arrays();
-	void recursive_create_penalty_array(Ref<IKBoneSegment3D> p_bone_segment, Vector<Vector<double>> &r_penalty_array, Vector<Ref<IKBone3D>> &r_pinned_bones, double p_falloff);
-	void segment_solver(const Vector<float> &p_damp, float p_default_damp, bool p_constraint_mode, int32_t p_current_iteration, int32_t p_total_iteration);
+	void recursive_create_penalty_array(Ref<IKBoneSegment3D> p_bone_segment, Vector<Vector<ik_real_t>> &r_penalty_array, Vector<Ref<IKBone3D>> &r_pinned_bones, ik_real_t p_falloff);
+	// p_cos_half_damp holds cos(damp / 2) per bone id, precomputed by the modifier; bones outside it use p_default_cos_half_damp.
+	void segment_solver(const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp, bool p_constraint_mode, int32_t p_current_iteration, int32_t p_total_iteration);
+	// Builds the reduced skeleton of the child segments below this root segment. Call once per rig, after the headings arrays exist.
+	void build_coarse_skeleton(IKNode3DPool *p_pool);
+	// Solves the reduced skeleton from the current pose for p_iterations, then spreads each virtual bone's rotation over its chain.
+	void coarse_solver(const Vector<ik_real_t> &p_cos_half_damp, ik_real_t p_default_cos_half_damp, int32_t p_iterations);
+	// Runs the solver step segment_solver() takes for one bone of this segment.
+	void solve_bone(const Ref<IKBone3D> &p_for_bone, ik_real_t p_cos_half_damp, bool p_constraint_mode);
+	// The score a stabilization trial starts from: the weighted mean square deviation of the bone's tip headings from the targets.
+	ik_real_t get_bone_deviation(const Ref<IKBone3D> &p_for_bone);
+	void update_solver_engines();
+	SolverEngine get_solver_engine() const;
 	Ref<IKBone3D> get_root() const;
 	Ref<IKBone3D> get_tip() const;
 	bool is_pinned() const;
 	Vector<Ref<IKBoneSegment3D>> get_child_segments() const;
+	// The score of the pose the last stabilized bone committed.
+	ik_real_t get_previous_deviation() const;
+	void set_previous_deviation(ik_real_t p_previous_deviation);
 	void create_bone_list(Vector<Ref<IKBone3D>> &p_list, bool p_recursive = false) const;
 	Ref<IKBone3D> get_ik_bone(BoneId p_bone) const;
 	void generate_default_segments(Vector<Ref<IKEffectorTemplate3D>> &p_pins, BoneId p_root_bone, BoneId p_tip_bone, ManyBoneIK3D *p_many_bone_ik);
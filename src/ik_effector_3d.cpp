@@ -50,6 +50,15 @@ NodePath IKEffector3D::get_target_node() const {
 	return target_node_path;
 }
 
+void IKEffector3D::set_pole_node(const NodePath &p_pole_node_path) {
+	pole_node_path = p_pole_node_path;
+	has_pole = false;
+}
+
+NodePath IKEffector3D::get_pole_node() const {
+	return pole_node_path;
+}
+
 void IKEffector3D::set_target_node_rotation(bool p_use) {
 	use_target_node_rotation = p_use;
 }
@@ -81,20 +90,33 @@ void IKEffector3D::update_target_global_transform(Skeleton3D *p_skeleton, ManyBo
 	if (current_target_node && current_target_node->is_visible_in_tree()) {
 		target_relative_to_skeleton_origin = p_skeleton->get_global_transform().affine_inverse() * current_target_node->get_global_transform();
 	}
+	Node3D *current_pole_node = pole_node_path.is_empty() ? nullptr : cast_to<Node3D>(p_many_bone_ik->get_node_or_null(pole_node_path));
+	has_pole = current_pole_node && current_pole_node->is_visible_in_tree();
+	if (has_pole) {
+		pole_relative_to_skeleton_origin = p_skeleton->get_global_transform().affine_inverse().xform(current_pole_node->get_global_transform().origin);
+	}
 }
 
 Transform3D IKEffector3D::get_target_global_transform() const {
 	return target_relative_to_skeleton_origin;
 }
 
-int32_t IKEffector3D::update_effector_target_headings(PackedVector3Array *p_headings, int32_t p_index, Ref<IKBone3D> p_for_bone, const Vector<double> *p_weights) const {
+void IKEffector3D::set_target_global_transform(const Transform3D &p_target) {
+	target_relative_to_skeleton_origin = p_target;
+}
+
+int32_t IKEffector3D::update_effector_target_headings(PackedVector3Array *p_headings, int32_t p_index, const Ref<IKBone3D> &p_for_bone, const Vector<ik_real_t> *p_weights) const {
+	ERR_FAIL_NULL_V(p_for_bone, -1);
+	return update_effector_target_headings(p_headings, p_index, p_for_bone->get_bone_direction_global_pose().origin, p_weights);
+}
+
+int32_t IKEffector3D::update_effector_target_headings(PackedVector3Array *p_headings, int32_t p_index, const Vector3 &p_origin, const Vector<ik_real_t> *p_weights) const {
 	ERR_FAIL_COND_V(p_index == -1, -1);
 	ERR_FAIL_NULL_V(p_headings, -1);
-	ERR_FAIL_NULL_V(p_for_bone, -1);
 	ERR_FAIL_NULL_V(p_weights, -1);
 
 	int32_t index = p_index;
-	Vector3 bone_origin_relative_to_skeleton_origin = for_bone->get_bone_direction_global_pose().origin;
+	const Vector3 &bone_origin_relative_to_skeleton_origin = p_origin;
 	p_headings->write[index] = target_relative_to_skeleton_origin.origin - bone_origin_relative_to_skeleton_origin;
 	index++;
 	Vector3 priority = get_direction_priorities();
@@ -115,20 +137,24 @@ int32_t IKEffector3D::update_effector_target_headings(PackedVector3Array *p_head
 	return index;
 }
 
-int32_t IKEffector3D::update_effector_tip_headings(PackedVector3Array *p_headings, int32_t p_index, Ref<IKBone3D> p_for_bone) const {
+int32_t IKEffector3D::update_effector_tip_headings(PackedVector3Array *p_headings, int32_t p_index, const Ref<IKBone3D> &p_for_bone) const {
+	ERR_FAIL_NULL_V(p_for_bone, -1);
+	return update_effector_tip_headings(p_headings, p_index, for_bone->get_bone_direction_global_pose(), p_for_bone->get_bone_direction_global_pose().origin);
+}
+
+int32_t IKEffector3D::update_effector_tip_headings(PackedVector3Array *p_headings, int32_t p_index, const Transform3D &p_tip, const Vector3 &p_origin) const {
 	ERR_FAIL_COND_V(p_index == -1, -1);
 	ERR_FAIL_NULL_V(p_headings, -1);
-	ERR_FAIL_NULL_V(p_for_bone, -1);
 
-	Transform3D tip_xform_relative_to_skeleton_origin = for_bone->get_bone_direction_global_pose();
+	const Transform3D &tip_xform_relative_to_skeleton_origin = p_tip;
 	Basis tip_basis = tip_xform_relative_to_skeleton_origin.basis;
-	Vector3 bone_origin_relative_to_skeleton_origin = p_for_bone->get_bone_direction_global_pose().origin;
+	const Vector3 &bone_origin_relative_to_skeleton_origin = p_origin;
 
 	int32_t index = p_index;
 	p_headings->write[index] = tip_xform_relative_to_skeleton_origin.origin - bone_origin_relative_to_skeleton_origin;
 	index++;
-	double distance = target_relative_to_skeleton_origin.origin.distance_to(bone_origin_relative_to_skeleton_origin);
-	double scale_by = MIN(distance, 1.0f);
+	ik_real_t distance = target_relative_to_skeleton_origin.origin.distance_to(bone_origin_relative_to_skeleton_origin);
+	ik_real_t scale_by = MIN(distance, ik_real_t(1.0));
 	const Vector3 priority = get_direction_priorities();
 
 	for (int axis = Vector3::AXIS_X; axis <= Vector3::AXIS_Z; ++axis) {
@@ -153,6 +179,10 @@ void IKEffector3D::_bind_methods() {
 			&IKEffector3D::set_target_node);
 	ClassDB::bind_method(D_METHOD("get_target_node"),
 			&IKEffector3D::get_target_node);
+	ClassDB::bind_method(D_METHOD("set_pole_node", "node"),
+			&IKEffector3D::set_pole_node);
+	ClassDB::bind_method(D_METHOD("get_pole_node"),
+			&IKEffector3D::get_pole_node);
 	ClassDB::bind_method(D_METHOD("set_motion_propagation_factor", "amount"),
 			&IKEffector3D::set_motion_propagation_factor);
 	ClassDB::bind_method(D_METHOD("get_motion_propagation_factor"),
@@ -32,6 +32,7 @@
 #define IK_EFFECTOR_3D_H
 
 #include "math/ik_node_3d.h"
+#include "math/ik_precision.h"
 
 #include "core/object/ref_counted.h"
 #include "scene/3d/skeleton_3d.h"
@@ -55,6 +56,10 @@ class IKEffector3D : public Resource {
 	Transform3D target_transform;
 
 	Transform3D target_relative_to_skeleton_origin;
+	NodePath pole_node_path;
+	// Where the bend of an analytic chain should point. Only meaningful while has_pole is set.
+	bool has_pole = false;
+	Vector3 pole_relative_to_skeleton_origin;
 	int32_t num_headings = 7;
 	// See IKEffectorTemplate to change the defaults.
 	real_t weight = 0.0;
@@ -74,18 +79,23 @@ public:
 	void set_direction_priorities(Vector3 p_direction_priorities);
 	Vector3 get_direction_priorities() const;
 	void update_target_global_transform(Skeleton3D *p_skeleton, ManyBoneIK3D *p_modification = nullptr);
-	const float MAX_KUSUDAMA_OPEN_CONES = 30;
 	float get_motion_propagation_factor() const;
 	void set_motion_propagation_factor(float p_motion_propagation_factor);
 	void set_target_node(Skeleton3D *p_skeleton, const NodePath &p_target_node_path);
 	NodePath get_target_node() const;
+	void set_pole_node(const NodePath &p_pole_node_path);
+	NodePath get_pole_node() const;
 	Transform3D get_target_global_transform() const;
+	void set_target_global_transform(const Transform3D &p_target);
 	void set_target_node_rotation(bool p_use);
 	bool get_target_node_rotation() const;
 	Ref<IKBone3D> get_ik_bone_3d() const;
 	bool is_following_translation_only() const;
-	int32_t update_effector_target_headings(PackedVector3Array *p_headings, int32_t p_index, Ref<IKBone3D> p_for_bone, const Vector<double> *p_weights) const;
-	int32_t update_effector_tip_headings(PackedVector3Array *p_headings, int32_t p_index, Ref<IKBone3D> p_for_bone) const;
+	int32_t update_effector_target_headings(PackedVector3Array *p_headings, int32_t p_index, const Ref<IKBone3D> &p_for_bone, const Vector<ik_real_t> *p_weights) const;
+	int32_t update_effector_tip_headings(PackedVector3Array *p_headings, int32_t p_index, const Ref<IKBone3D> &p_for_bone) const;
+	// The same headings measured from explicit poses instead of the bones, for the reduced skeleton of the coarse solve.
+	int32_t update_effector_target_headings(PackedVector3Array *p_headings, int32_t p_index, const Vector3 &p_origin, const Vector<ik_real_t> *p_weights) const;
+	int32_t update_effector_tip_headings(PackedVector3Array *p_headings, int32_t p_index, const Transform3D &p_tip, const Vector3 &p_origin) const;
 	IKEffector3D(const Ref<IKBone3D> &p_current_bone);
 };
 
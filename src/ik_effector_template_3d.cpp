@@ -39,6 +39,9 @@ void IKEffectorTemplate3D::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_target_node"), &IKEffectorTemplate3D::get_target_node);
 	ClassDB::bind_method(D_METHOD("set_target_node", "target_node"), &IKEffectorTemplate3D::set_target_node);
 
+	ClassDB::bind_method(D_METHOD("get_pole_node"), &IKEffectorTemplate3D::get_pole_node);
+	ClassDB::bind_method(D_METHOD("set_pole_node", "pole_node"), &IKEffectorTemplate3D::set_pole_node);
+
 	ClassDB::bind_method(D_METHOD("get_motion_propagation_factor"), &IKEffectorTemplate3D::get_motion_propagation_factor);
 	ClassDB::bind_method(D_METHOD("set_motion_propagation_factor", "motion_propagation_factor"), &IKEffectorTemplate3D::set_motion_propagation_factor);
 
@@ -52,6 +55,7 @@ void IKEffectorTemplate3D::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "weight"), "set_weight", "get_weight");
 	ADD_PROPERTY(PropertyInfo(Variant::VECTOR3, "direction_priorities"), "set_direction_priorities", "get_direction_priorities");
 	ADD_PROPERTY(PropertyInfo(Variant::NODE_PATH, "target_node"), "set_target_node", "get_target_node");
+	ADD_PROPERTY(PropertyInfo(Variant::NODE_PATH, "pole_node"), "set_pole_node", "get_pole_node");
 	ADD_PROPERTY(PropertyInfo(Variant::STRING_NAME, "root_bone"), "set_root_bone", "get_root_bone");
 }
 
@@ -63,6 +67,14 @@ void IKEffectorTemplate3D::set_target_node(NodePath p_node_path) {
 	target_node = p_node_path;
 }
 
+NodePath IKEffectorTemplate3D::get_pole_node() const {
+	return pole_node;
+}
+
+void IKEffectorTemplate3D::set_pole_node(NodePath p_node_path) {
+	pole_node = p_node_path;
+}
+
 float IKEffectorTemplate3D::get_motion_propagation_factor() const {
 	return motion_propagation_factor;
 }
@@ -39,6 +39,7 @@ class IKEffectorTemplate3D : public Resource {
 
 	StringName root_bone;
 	NodePath target_node;
+	NodePath pole_node;
 	bool target_static = false;
 	real_t motion_propagation_factor = 1.0f;
 	real_t weight = 0.0f;
@@ -51,6 +52,8 @@ public:
 	void set_root_bone(String p_root_bone);
 	NodePath get_target_node() const;
 	void set_target_node(NodePath p_node_path);
+	NodePath get_pole_node() const;
+	void set_pole_node(NodePath p_node_path);
 	float get_motion_propagation_factor() const;
 	void set_motion_propagation_factor(float p_motion_propagation_factor);
 	real_t get_weight() const { return weight; }
@@ -31,6 +31,8 @@
 #include "ik_kusudama_3d.h"
 
 #include "core/math/quaternion.h"
+#include "core/templates/local_vector.h"
+#include "core/templates/pair.h"
 #include "ik_open_cone_3d.h"
 #include "math/ik_node_3d.h"
 
@@ -114,7 +116,7 @@ void IKKusudama3D::set_axial_limits(real_t min_angle, real_t in_range) {
 	twist_max_rot = Quaternion(z_axis, twist_max_vec);
 }
 
-void IKKusudama3D::set_snap_to_twist_limit(Ref<IKNode3D> p_bone_direction, Ref<IKNode3D> p_to_set, Ref<IKNode3D> p_constraint_axes, real_t p_dampening, real_t p_cos_half_dampen) {
+void IKKusudama3D::set_snap_to_twist_limit(const Ref<IKNode3D> &p_bone_direction, const Ref<IKNode3D> &p_to_set, const Ref<IKNode3D> &p_constraint_axes, real_t p_dampening, real_t p_cos_half_dampen) {
 	if (!is_axially_constrained()) {
 		return;
 	}
@@ -131,6 +133,52 @@ void IKKusudama3D::set_snap_to_twist_limit(Ref<IKNode3D> p_bone_direction, Ref<I
 	p_to_set->set_transform(Transform3D(rotation, p_to_set->get_transform().origin));
 }
 
+void IKKusudama3D::snap_to_limits(const Ref<IKNode3D> &p_bone_direction, const Ref<IKNode3D> &p_to_set, const Ref<IKNode3D> &p_limiting_axes, const Ref<IKNode3D> &p_twist_axes) {
+	ERR_FAIL_COND(p_bone_direction.is_null() || p_to_set.is_null() || p_limiting_axes.is_null() || p_twist_axes.is_null());
+	bool orientation = is_orientationally_constrained();
+	bool axial = is_axially_constrained();
+	if (!orientation && !axial) {
+		return;
+	}
+	Ref<IKNode3D> parent = p_to_set->get_parent();
+	ERR_FAIL_COND(parent.is_null());
+	// Only the rotation is constrained, the bone keeps its local scale.
+	Transform3D local_transform = p_to_set->get_transform();
+	Vector3 local_scale = local_transform.basis.get_scale();
+	Quaternion parent_global_rotation = parent->get_global_transform().basis.get_rotation_quaternion();
+	Quaternion global_rotation = parent_global_rotation * local_transform.basis.get_rotation_quaternion();
+	bool changed = false;
+	if (orientation) {
+		Transform3D limiting_transform = p_limiting_axes->get_global_transform();
+		Vector3 bone_tip = p_bone_direction->get_global_transform().xform(Vector3(0.0, 1.0, 0.0));
+		double in_bounds = 1.0;
+		Vector3 in_limits = get_local_point_in_limits(limiting_transform.affine_inverse().xform(bone_tip), &in_bounds);
+		if (in_bounds < 0) {
+			// A scaled bone has a heading of any length, and the shortest arc needs unit vectors.
+			Vector3 bone_heading = (bone_tip - limiting_transform.origin).normalized();
+			Vector3 limit_heading = (limiting_transform.xform(in_limits) - limiting_transform.origin).normalized();
+			Quaternion swing = Quaternion(bone_heading, limit_heading);
+			global_rotation = (swing * global_rotation).normalized();
+			changed = true;
+		}
+	}
+	if (axial) {
+		Quaternion global_twist_center = p_twist_axes->get_global_transform().basis.get_rotation_quaternion() * twist_center_rot;
+		Quaternion twist_rotation, swing_rotation;
+		get_swing_twist((global_twist_center.inverse() * global_rotation).normalized(), Vector3(0, 1, 0), swing_rotation, twist_rotation);
+		// The twist only moves when it is outside the range. Its sign does not matter, so compare against |w|.
+		if (Math::abs(twist_rotation.w) < twist_half_range_half_cos) {
+			twist_rotation = IKBoneSegment3D::clamp_to_cos_half_angle(twist_rotation, twist_half_range_half_cos);
+			global_rotation = (global_twist_center * (swing_rotation * twist_rotation)).normalized();
+			changed = true;
+		}
+	}
+	if (changed) {
+		Quaternion local_rotation = (parent_global_rotation.inverse() * global_rotation).normalized();
+		p_to_set->set_transform(Transform3D(Basis(local_rotation, local_scale), local_transform.origin));
+	}
+}
+
 void IKKusudama3D::get_swing_twist(
 		Quaternion p_rotation,
 		Vector3 p_axis,
@@ -271,21 +319,25 @@ Vector3 IKKusudama3D::local_point_on_path_sequence(Vector3 p_in_point, Ref<IKNod
  * @return the original point, if it's in limits, or the closest point which is in limits.
  */
 Vector3 IKKusudama3D::get_local_point_in_limits(Vector3 in_point, Vector<double> *in_bounds) {
+	return get_local_point_in_limits(in_point, in_bounds->ptrw());
+}
+
+Vector3 IKKusudama3D::get_local_point_in_limits(const Vector3 &in_point, double *in_bounds) {
 	// Normalize the input point
 	Vector3 point = in_point.normalized();
 	real_t closest_cos = -2.0;
-	in_bounds->write[0] = -1;
+	*in_bounds = -1;
 
 	Vector3 closest_collision_point = in_point;
 
 	// Loop through each limit cone
 	for (int i = 0; i < open_cones.size(); i++) {
-		Ref<IKLimitCone3D> cone = open_cones[i];
+		const Ref<IKLimitCone3D> &cone = open_cones[i];
 		Vector3 collision_point = cone->closest_to_cone(point, in_bounds);
 
 		// If the collision point is NaN, return the original point
 		if (Math::is_nan(collision_point.x) || Math::is_nan(collision_point.y) || Math::is_nan(collision_point.z)) {
-			in_bounds->write[0] = 1;
+			*in_bounds = 1;
 			return point;
 		}
 
@@ -300,10 +352,10 @@ Vector3 IKKusudama3D::get_local_point_in_limits(Vector3 in_point, Vector<double>
 	}
 
 	// If we're out of bounds of all cones, check if we're in the paths between the cones
-	if ((*in_bounds)[0] == -1) {
+	if (*in_bounds == -1) {
 		for (int i = 0; i < open_cones.size() - 1; i++) {
-			Ref<IKLimitCone3D> currCone = open_cones[i];
-			Ref<IKLimitCone3D> nextCone = open_cones[i + 1];
+			const Ref<IKLimitCone3D> &currCone = open_cones[i];
+			const Ref<IKLimitCone3D> &nextCone = open_cones[i + 1];
 			Vector3 collision_point = currCone->get_on_great_tangent_triangle(nextCone, point);
 
 			// If the collision point is NaN, skip to the next iteration
@@ -315,7 +367,7 @@ Vector3 IKKusudama3D::get_local_point_in_limits(Vector3 in_point, Vector<double>
 
 			// If the cosine is approximately 1, return the original point
 			if (Math::is_equal_approx(this_cos, real_t(1.0))) {
-				in_bounds->write[0] = 1;
+				*in_bounds = 1;
 				return point;
 			}
 
@@ -331,6 +383,28 @@ Vector3 IKKusudama3D::get_local_point_in_limits(Vector3 in_point, Vector<double>
 	return closest_collision_point;
 }
 
+bool IKKusudama3D::is_at_orientation_limit(Vector3 p_point, double p_tolerance) {
+	Vector3 point = p_point.normalized();
+	double in_bounds = 1.0;
+	get_local_point_in_limits(point, &in_bounds);
+	if (in_bounds < 0) {
+		return true;
+	}
+	// Probe a ring of directions p_tolerance away against the same cones and tangent paths the snap uses.
+	// A direction was snapped onto the boundary if any probe leaves them.
+	Vector3 tangent = point.cross(Math::abs(point.x) < 0.9 ? Vector3(1, 0, 0) : Vector3(0, 1, 0)).normalized();
+	const int32_t probe_count = 8;
+	for (int32_t probe_i = 0; probe_i < probe_count; probe_i++) {
+		Vector3 axis = tangent.rotated(point, Math_TAU * probe_i / probe_count);
+		double probe_bounds = 1.0;
+		get_local_point_in_limits(point.rotated(axis, p_tolerance), &probe_bounds);
+		if (probe_bounds < 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void IKKusudama3D::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_open_cones"), &IKKusudama3D::get_open_cones);
 	ClassDB::bind_method(D_METHOD("set_open_cones", "open_cones"), &IKKusudama3D::set_open_cones);
@@ -344,7 +418,7 @@ void IKKusudama3D::set_open_cones(TypedArray<IKLimitCone3D> p_cones) {
 	}
 }
 
-void IKKusudama3D::snap_to_orientation_limit(Ref<IKNode3D> bone_direction, Ref<IKNode3D> to_set, Ref<IKNode3D> limiting_axes, real_t p_dampening, real_t p_cos_half_angle_dampen) {
+void IKKusudama3D::snap_to_orientation_limit(const Ref<IKNode3D> &bone_direction, const Ref<IKNode3D> &to_set, const Ref<IKNode3D> &limiting_axes, real_t p_dampening, real_t p_cos_half_angle_dampen) {
 	if (bone_direction.is_null()) {
 		return;
 	}
@@ -354,23 +428,17 @@ void IKKusudama3D::snap_to_orientation_limit(Ref<IKNode3D> bone_direction, Ref<I
 	if (limiting_axes.is_null()) {
 		return;
 	}
-	Vector<double> in_bounds;
-	in_bounds.resize(1);
-	in_bounds.write[0] = 1.0;
+	double in_bounds = 1.0;
 	Vector3 limiting_origin = limiting_axes->get_global_transform().origin;
 	Vector3 bone_dir_xform = bone_direction->get_global_transform().xform(Vector3(0.0, 1.0, 0.0));
 
-	bone_ray->set_point_1(limiting_origin);
-	bone_ray->set_point_2(bone_dir_xform);
-
-	Vector3 bone_tip = limiting_axes->to_local(bone_ray->get_point_2());
+	Vector3 bone_tip = limiting_axes->to_local(bone_dir_xform);
 	Vector3 in_limits = get_local_point_in_limits(bone_tip, &in_bounds);
 
-	if (in_bounds[0] < 0) {
-		constrained_ray->set_point_1(bone_ray->get_point_1());
-		constrained_ray->set_point_2(limiting_axes->to_global(in_limits));
-
-		Quaternion rectified_rot = Quaternion(bone_ray->get_heading(), constrained_ray->get_heading());
+	if (in_bounds < 0) {
+		Vector3 bone_heading = bone_dir_xform - limiting_origin;
+		Vector3 constrained_heading = limiting_axes->to_global(in_limits) - limiting_origin;
+		Quaternion rectified_rot = Quaternion(bone_heading, constrained_heading);
 		to_set->rotate_local_with_global(rectified_rot);
 	}
 }
@@ -387,6 +455,120 @@ float IKKusudama3D::get_resistance() {
 	return resistance;
 }
 
+Vector<Vector4> IKKusudama3D::fit_open_cones(const PackedVector3Array &p_directions, real_t p_max_radius) {
+	LocalVector<Vector3> points;
+	for (const Vector3 &direction : p_directions) {
+		if (!direction.is_zero_approx()) {
+			points.push_back(direction.normalized());
+		}
+	}
+	if (points.is_empty()) {
+		return Vector<Vector4>();
+	}
+
+	// Greedy farthest point cover: keep adding the worst covered sample as a new center until every sample is close enough to one.
+	LocalVector<uint32_t> seeds;
+	LocalVector<uint32_t> assignment;
+	LocalVector<real_t> distance;
+	assignment.resize(points.size());
+	distance.resize(points.size());
+	for (uint32_t point_i = 0; point_i < points.size(); point_i++) {
+		distance[point_i] = INFINITY;
+	}
+	uint32_t next_seed = 0;
+	while (true) {
+		seeds.push_back(next_seed);
+		const Vector3 seed_point = points[next_seed];
+		real_t farthest = 0.0;
+		for (uint32_t point_i = 0; point_i < points.size(); point_i++) {
+			real_t angle = points[point_i].angle_to(seed_point);
+			if (angle < distance[point_i]) {
+				distance[point_i] = angle;
+				assignment[point_i] = seeds.size() - 1;
+			}
+			if (distance[point_i] > farthest) {
+				farthest = distance[point_i];
+				next_seed = point_i;
+			}
+		}
+		if (farthest <= p_max_radius || seeds.size() == points.size()) {
+			break;
+		}
+	}
+
+	struct Cluster {
+		Vector3 sum;
+		uint32_t first_sample = UINT32_MAX;
+	};
+	LocalVector<Cluster> clusters;
+	clusters.resize(seeds.size());
+	for (uint32_t point_i = 0; point_i < points.size(); point_i++) {
+		Cluster &cluster = clusters[assignment[point_i]];
+		cluster.sum += points[point_i];
+		cluster.first_sample = MIN(cluster.first_sample, point_i);
+	}
+	LocalVector<Pair<uint32_t, Vector4>> ordered;
+	for (uint32_t cluster_i = 0; cluster_i < clusters.size(); cluster_i++) {
+		// The mean direction usually gives a tighter cone than the seed sample.
+		Vector3 seed = points[seeds[cluster_i]];
+		Vector3 mean = clusters[cluster_i].sum.is_zero_approx() ? seed : clusters[cluster_i].sum.normalized();
+		real_t seed_radius = 0.0;
+		real_t mean_radius = 0.0;
+		for (uint32_t point_i = 0; point_i < points.size(); point_i++) {
+			if (assignment[point_i] != cluster_i) {
+				continue;
+			}
+			seed_radius = MAX(seed_radius, points[point_i].angle_to(seed));
+			mean_radius = MAX(mean_radius, points[point_i].angle_to(mean));
+		}
+		Vector3 center = mean_radius < seed_radius ? mean : seed;
+		real_t radius = MAX(MIN(mean_radius, seed_radius), real_t(CMP_EPSILON));
+		ordered.push_back(Pair<uint32_t, Vector4>(clusters[cluster_i].first_sample, Vector4(center.x, center.y, center.z, radius)));
+	}
+	ordered.sort_custom<PairSort<uint32_t, Vector4>>();
+
+	Vector<Vector4> cones;
+	for (const Pair<uint32_t, Vector4> &cone : ordered) {
+		cones.push_back(cone.second);
+	}
+	return cones;
+}
+
+Vector<Vector4> IKKusudama3D::simplify_open_cones(const Vector<Vector4> &p_cones, real_t p_tolerance) {
+	Vector<Vector4> cones = p_cones;
+	bool merged = true;
+	while (merged && cones.size() > 1) {
+		merged = false;
+		for (int32_t cone_i = 0; cone_i < cones.size() - 1; cone_i++) {
+			const Vector4 &cone = cones[cone_i];
+			const Vector4 &next = cones[cone_i + 1];
+			Vector3 center = Vector3(cone.x, cone.y, cone.z).normalized();
+			Vector3 next_center = Vector3(next.x, next.y, next.z).normalized();
+			real_t separation = center.angle_to(next_center);
+			if (separation + cone.w <= next.w + p_tolerance) {
+				cones.remove_at(cone_i);
+				merged = true;
+				break;
+			}
+			if (separation + next.w <= cone.w + p_tolerance) {
+				cones.remove_at(cone_i + 1);
+				merged = true;
+				break;
+			}
+			// The smallest cone holding both spans the two far edges, centred on the arc between them.
+			real_t radius = (separation + cone.w + next.w) / 2.0;
+			if (radius <= MAX(cone.w, next.w) + p_tolerance) {
+				Vector3 merged_center = center.slerp(next_center, (radius - cone.w) / separation);
+				cones.write[cone_i] = Vector4(merged_center.x, merged_center.y, merged_center.z, radius);
+				cones.remove_at(cone_i + 1);
+				merged = true;
+				break;
+			}
+		}
+	}
+	return cones;
+}
+
 Quaternion IKKusudama3D::clamp_to_quadrance_angle(Quaternion p_rotation, double p_cos_half_angle) {
 #ifdef MATH_CHECKS
 	ERR_FAIL_COND_V_MSG(!p_rotation.is_normalized(), Quaternion(), "The quaternion must be normalized.");
@@ -39,6 +39,7 @@
 
 #include "core/io/resource.h"
 #include "core/math/quaternion.h"
+#include "core/math/vector4.h"
 #include "core/object/ref_counted.h"
 #include "core/variant/typed_array.h"
 #include "scene/3d/node_3d.h"
@@ -92,8 +93,6 @@ public:
 
 	void update_tangent_radii();
 
-	Ref<IKRay3D> bone_ray = Ref<IKRay3D>(memnew(IKRay3D()));
-	Ref<IKRay3D> constrained_ray = Ref<IKRay3D>(memnew(IKRay3D()));
 	double unit_hyper_area = 2 * Math::pow(Math_PI, 2);
 	double unit_area = 4 * Math_PI;
 
@@ -122,7 +121,7 @@ public:
 	 *
 	 * @param to_set
 	 */
-	void snap_to_orientation_limit(Ref<IKNode3D> p_bone_direction, Ref<IKNode3D> p_to_set, Ref<IKNode3D> p_limiting_axes, real_t p_dampening, real_t p_cos_half_angle_dampen);
+	void snap_to_orientation_limit(const Ref<IKNode3D> &p_bone_direction, const Ref<IKNode3D> &p_to_set, const Ref<IKNode3D> &p_limiting_axes, real_t p_dampening, real_t p_cos_half_angle_dampen);
 
 	bool is_nan_vector(const Vector3 &vec);
 
@@ -145,7 +144,22 @@ public:
 	 * @param limiting_axes
 	 * @return radians of the twist required to snap bone into twist limits (0 if bone is already in twist limits)
 	 */
-	void set_snap_to_twist_limit(Ref<IKNode3D> p_bone_direction, Ref<IKNode3D> p_to_set, Ref<IKNode3D> p_limiting_axes, real_t p_dampening, real_t p_cos_half_dampen);
+	void set_snap_to_twist_limit(const Ref<IKNode3D> &p_bone_direction, const Ref<IKNode3D> &p_to_set, const Ref<IKNode3D> &p_limiting_axes, real_t p_dampening, real_t p_cos_half_dampen);
+
+	/**
+	 * Applies both limits in one pass: the swing is snapped into the open cones, then the twist is clamped
+	 * into the axial range, working on the global rotation of to_set. The local scale of to_set is kept.
+	 * The result is written back with a single set_transform, and only when a limit moved the bone, so the
+	 * hierarchy below to_set is invalidated at most once.
+	 * For unscaled transforms this gives the same rotation as snap_to_orientation_limit followed by
+	 * set_snap_to_twist_limit. Both of those ignore their dampening arguments, so this takes none.
+	 *
+	 * @param p_bone_direction the bone direction transform, a descendant of p_to_set.
+	 * @param p_to_set the transform to rotate into limits.
+	 * @param p_limiting_axes the orientation frame the open cones are expressed in.
+	 * @param p_twist_axes the frame the twist range is measured in.
+	 */
+	void snap_to_limits(const Ref<IKNode3D> &p_bone_direction, const Ref<IKNode3D> &p_to_set, const Ref<IKNode3D> &p_limiting_axes, const Ref<IKNode3D> &p_twist_axes);
 
 	/**
 	 * Given a point (in local coordinates), checks to see if a ray can be extended from the Kusudama's
@@ -163,6 +177,18 @@ public:
 	 * @return the original point, if it's in limits, or the closest point which is in limits.
 	 */
 	Vector3 get_local_point_in_limits(Vector3 in_point, Vector<double> *in_bounds);
+	// Same as above, with only the boundary flag written through a plain pointer so the constraint hot path needs no Vector.
+	Vector3 get_local_point_in_limits(const Vector3 &in_point, double *in_bounds);
+
+	/**
+	 * Whether a local direction is pinned against the orientation limits.
+	 *
+	 * @param p_point the direction to test, in the limiting axes' space.
+	 * @param p_tolerance angle in radians within which a direction inside the limits still counts as touching their boundary.
+	 * @return true if the direction is out of bounds, or within p_tolerance of the boundary that get_local_point_in_limits
+	 * snaps to, which includes the tangent paths between consecutive cones.
+	 */
+	bool is_at_orientation_limit(Vector3 p_point, double p_tolerance);
 
 	Vector3 local_point_on_path_sequence(Vector3 in_point, Ref<IKNode3D> limiting_axes);
 
@@ -198,6 +224,22 @@ public:
 	float get_resistance();
 	void set_resistance(float p_resistance);
 	static Quaternion clamp_to_quadrance_angle(Quaternion p_rotation, double p_cos_half_angle);
+
+	/**
+	 * Fits the fewest cones of at most p_max_radius that cover the sampled directions, in the same
+	 * (x, y, z, radius) layout as ManyBoneIK3D's open cones. Cones are ordered by the first sample they cover,
+	 * so for recorded motion consecutive cones follow the path and are joined by their tangent circles.
+	 *
+	 * @param p_directions directions in the limiting axes' space, usually sampled over an animation.
+	 * @param p_max_radius the largest cone radius in radians.
+	 */
+	static Vector<Vector4> fit_open_cones(const PackedVector3Array &p_directions, real_t p_max_radius);
+
+	/**
+	 * Merges redundant neighbouring cones. A cone that pokes out of its neighbour by at most p_tolerance radians is
+	 * dropped, and two neighbours are replaced by their enclosing cone when it is at most p_tolerance wider than the larger one.
+	 */
+	static Vector<Vector4> simplify_open_cones(const Vector<Vector4> &p_cones, real_t p_tolerance);
 };
 
 #endif // IK_KUSUDAMA_3D_H
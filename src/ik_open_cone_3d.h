@@ -93,6 +93,7 @@ class IKLimitCone3D : public Resource {
 	 * @return
 	 */
 	Vector3 _closest_point_on_closest_cone(Ref<IKLimitCone3D> next, Vector3 input, Vector<double> *in_bounds) const;
+	Vector3 _closest_point_on_closest_cone(const Ref<IKLimitCone3D> &next, const Vector3 &input, double *in_bounds) const;
 
 	double _get_tangent_circle_radius_next_cos();
 
@@ -123,6 +124,8 @@ public:
 	 * @return
 	 */
 	Vector3 closest_to_cone(Vector3 input, Vector<double> *in_bounds) const;
+	// Same as above, with the bounds flag written through a plain pointer so hot paths need no Vector.
+	Vector3 closest_to_cone(const Vector3 &input, double *in_bounds) const;
 	Vector3 get_closest_path_point(Ref<IKLimitCone3D> next, Vector3 input) const;
 	Vector3 get_control_point() const;
 	void set_control_point(Vector3 p_control_point);
@@ -62,14 +62,18 @@ real_t IKRay3D::get_scaled_projection(const Vector3 p_input) {
 }
 
 void IKRay3D::elongate(real_t amt) {
-	Vector3 midPoint = (point_1 + point_2) * 0.5f;
-	Vector3 p1Heading = point_1 - midPoint;
-	Vector3 p2Heading = point_2 - midPoint;
-	Vector3 p1Add = p1Heading.normalized() * amt;
-	Vector3 p2Add = p2Heading.normalized() * amt;
+	elongate_segment(point_1, point_2, amt);
+}
+
+void IKRay3D::elongate_segment(Vector3 &r_point_1, Vector3 &r_point_2, real_t p_amount) {
+	Vector3 midPoint = (r_point_1 + r_point_2) * 0.5f;
+	Vector3 p1Heading = r_point_1 - midPoint;
+	Vector3 p2Heading = r_point_2 - midPoint;
+	Vector3 p1Add = p1Heading.normalized() * p_amount;
+	Vector3 p2Add = p2Heading.normalized() * p_amount;
 
-	point_1 = p1Heading + p1Add + midPoint;
-	point_2 = p2Heading + p2Add + midPoint;
+	r_point_1 = p1Heading + p1Add + midPoint;
+	r_point_2 = p2Heading + p2Add + midPoint;
 }
 
 Vector3 IKRay3D::get_intersects_plane(Vector3 ta, Vector3 tb, Vector3 tc) {
@@ -84,6 +88,43 @@ Vector3 IKRay3D::get_intersects_plane(Vector3 ta, Vector3 tb, Vector3 tc) {
 	return result + point_1;
 }
 
+Vector3 IKRay3D::intersect_plane(const Vector3 &p_point_1, const Vector3 &p_point_2, const Vector3 &p_vertex_a, const Vector3 &p_vertex_b, const Vector3 &p_vertex_c) {
+	// Same as plane_intersect_test with the ray moved to the origin, without the unused barycentric coordinates.
+	Vector3 ta = p_vertex_a - p_point_1;
+	Vector3 normal = (p_vertex_b - p_vertex_a).cross(p_vertex_c - p_vertex_a).normalized();
+	Vector3 heading = p_point_2 - p_point_1;
+	real_t r = normal.dot(ta) / normal.dot(heading);
+	return heading * r + p_point_1;
+}
+
+int IKRay3D::intersect_sphere(const Vector3 &p_point_1, const Vector3 &p_point_2, const Vector3 &p_sphere_center, real_t p_radius, Vector3 *r_first_intersection, Vector3 *r_second_intersection) {
+	Vector3 rp1 = p_point_1 - p_sphere_center;
+	Vector3 e = (p_point_2 - p_point_1).normalized();
+	Vector3 h = -rp1;
+	real_t lf = e.dot(h);
+	real_t s = p_radius * p_radius - h.length_squared() + lf * lf;
+	if (s < 0.0f) {
+		*r_first_intersection += p_sphere_center;
+		*r_second_intersection += p_sphere_center;
+		return 0;
+	}
+	s = Math::sqrt(s);
+
+	int result = 0;
+	if (lf < s) {
+		if (lf + s >= 0) {
+			s = -s;
+			result = 1;
+		}
+	} else {
+		result = 2;
+	}
+
+	*r_first_intersection = e * (lf - s) + rp1 + p_sphere_center;
+	*r_second_intersection = e * (lf + s) + rp1 + p_sphere_center;
+	return result;
+}
+
 int IKRay3D::intersects_sphere(Vector3 sphereCenter, real_t radius, Vector3 *S1, Vector3 *S2) {
 	Vector3 tp1 = point_1 - sphereCenter;
 	Vector3 tp2 = point_2 - sphereCenter;
@@ -120,6 +120,13 @@ public:
 	real_t triangle_area_2d(real_t p_x1, real_t p_y1, real_t p_x2, real_t p_y2, real_t p_x3, real_t p_y3);
 	void barycentric(Vector3 p_a, Vector3 p_b, Vector3 p_c, Vector3 p_p, Vector3 *r_uvw);
 	Vector3 plane_intersect_test(Vector3 p_vertex_a, Vector3 p_vertex_b, Vector3 p_vertex_c, Vector3 *uvw);
+
+	// Value forms of the queries above, taking the ray as two points. The limit cone math runs in the
+	// constraint hot path and uses these instead of allocating an IKRay3D per query.
+	static void elongate_segment(Vector3 &r_point_1, Vector3 &r_point_2, real_t p_amount);
+	static Vector3 intersect_plane(const Vector3 &p_point_1, const Vector3 &p_point_2, const Vector3 &p_vertex_a, const Vector3 &p_vertex_b, const Vector3 &p_vertex_c);
+	static int intersect_sphere(const Vector3 &p_point_1, const Vector3 &p_point_2, const Vector3 &p_sphere_center, real_t p_radius, Vector3 *r_first_intersection, Vector3 *r_second_intersection);
+
 	operator String() const {
 		return String(L"(") + point_1.x + L" ->  " + point_2.x + L") \n " + L"(" + point_1.y + L" ->  " + point_2.y + L") \n " + L"(" + point_1.z + L" ->  " + point_2.z + L") \n ";
 	}
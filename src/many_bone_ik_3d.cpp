@@ -29,6 +29,7 @@
 /**************************************************************************/
 
 #include "many_bone_ik_3d.h"
+#include "core/config/engine.h"
 #include "core/error/error_macros.h"
 #include "core/math/math_defs.h"
 #include "core/object/class_db.h"
@@ -37,7 +38,10 @@
 #include "ik_bone_3d.h"
 #include "ik_kusudama_3d.h"
 #include "ik_open_cone_3d.h"
+#include "many_bone_ik_3d_state.h"
 #include "scene/3d/skeleton_3d.h"
+#include "scene/animation/animation_player.h"
+#include "scene/resources/animation_library.h"
 #include "scene/main/node.h"
 #include "scene/main/scene_tree.h"
 
@@ -76,6 +80,24 @@ NodePath ManyBoneIK3D::get_effector_target_node_path(int32_t p_pin_index) {
 	return effector_template->get_target_node();
 }
 
+void ManyBoneIK3D::set_pin_pole_node_path(int32_t p_pin_index, const NodePath &p_pole_node) {
+	ERR_FAIL_INDEX(p_pin_index, pins.size());
+	Ref<IKEffectorTemplate3D> effector_template = pins[p_pin_index];
+	if (effector_template.is_null()) {
+		effector_template.instantiate();
+		pins.write[p_pin_index] = effector_template;
+	}
+	effector_template->set_pole_node(p_pole_node);
+	set_dirty();
+}
+
+NodePath ManyBoneIK3D::get_pin_pole_node_path(int32_t p_pin_index) const {
+	ERR_FAIL_INDEX_V(p_pin_index, pins.size(), NodePath());
+	const Ref<IKEffectorTemplate3D> effector_template = pins[p_pin_index];
+	ERR_FAIL_NULL_V(effector_template, NodePath());
+	return effector_template->get_pole_node();
+}
+
 Vector<Ref<IKEffectorTemplate3D>> ManyBoneIK3D::_get_bone_effectors() const {
 	return pins;
 }
@@ -89,34 +111,163 @@ void ManyBoneIK3D::_remove_pin(int32_t p_index) {
 }
 
 void ManyBoneIK3D::_update_ik_bones_transform() {
-	for (int32_t bone_i = bone_list.size(); bone_i-- > 0;) {
-		Ref<IKBone3D> bone = bone_list[bone_i];
+	if (background_solve_task != WorkerThreadPool::INVALID_TASK_ID) {
+		return;
+	}
+	_read_rig_pose(bone_list);
+}
+
+void ManyBoneIK3D::_read_rig_pose(const Vector<Ref<IKBone3D>> &p_bones) {
+	Skeleton3D *skeleton = get_skeleton();
+	ERR_FAIL_NULL(skeleton);
+	const int32_t bone_count = skeleton->get_bone_count();
+	pose_changed_mask.resize(bone_count);
+	for (uint8_t &changed : pose_changed_mask) {
+		changed = 0;
+	}
+	// The list holds child segments first and each segment from tip to root, so walking it backwards visits parents before
+	// their children. The mask then says whether a bone or one of its ancestors changed, and only the topmost changed bone of
+	// each subtree invalidates the global transforms below it.
+	for (int32_t bone_i = p_bones.size(); bone_i-- > 0;) {
+		const Ref<IKBone3D> &bone = p_bones[bone_i];
 		if (bone.is_null()) {
 			continue;
 		}
-		bone->set_initial_pose(get_skeleton());
-		if (bone->is_pinned()) {
-			bone->get_pin()->update_target_global_transform(get_skeleton(), this);
+		const Ref<IKBone3D> parent = bone->get_parent();
+		const BoneId parent_id = parent.is_valid() ? parent->get_bone_id() : -1;
+		const bool ancestor_changed = parent_id >= 0 && parent_id < bone_count && pose_changed_mask[parent_id];
+		const bool changed = bone->set_initial_pose(skeleton);
+		if (changed && !ancestor_changed) {
+			bone->get_ik_transform()->_propagate_transform_changed();
+		}
+		const BoneId bone_id = bone->get_bone_id();
+		if (bone_id >= 0 && bone_id < bone_count) {
+			pose_changed_mask[bone_id] = changed || ancestor_changed;
+		}
+		if (bone->is_pinned() && !keep_restored_targets) {
+			bone->get_pin()->update_target_global_transform(skeleton, this);
 		}
 	}
 }
 
 void ManyBoneIK3D::_update_skeleton_bones_transform() {
+	Skeleton3D *skeleton = get_skeleton();
+	ERR_FAIL_NULL(skeleton);
 	for (int32_t bone_i = bone_list.size(); bone_i-- > 0;) {
-		Ref<IKBone3D> bone = bone_list[bone_i];
+		const Ref<IKBone3D> &bone = bone_list[bone_i];
 		if (bone.is_null()) {
 			continue;
 		}
 		if (bone->get_bone_id() == -1) {
 			continue;
 		}
-		bone->set_skeleton_bone_pose(get_skeleton());
+		bone->set_skeleton_bone_pose(skeleton);
+	}
+	if (Engine::get_singleton()->is_editor_hint()) {
+		_store_published_constraints();
+		update_gizmos();
+	}
+}
+
+void ManyBoneIK3D::_update_effector_targets() {
+	if (keep_restored_targets) {
+		return;
+	}
+	for (int32_t bone_i = bone_list.size(); bone_i-- > 0;) {
+		Ref<IKBone3D> bone = bone_list[bone_i];
+		if (bone.is_null() || !bone->is_pinned()) {
+			continue;
+		}
+		bone->get_pin()->update_target_global_transform(get_skeleton(), this);
+	}
+}
+
+ManyBoneIK3D::SolveSettings ManyBoneIK3D::_get_solve_settings() const {
+	SolveSettings settings;
+	settings.iterations = get_iterations_per_frame();
+	settings.coarse_iterations = coarse_iterations;
+	settings.constraint_mode = get_constraint_mode();
+	settings.bone_cos_half_damp = bone_cos_half_damp;
+	settings.default_cos_half_damp = default_cos_half_damp;
+	return settings;
+}
+
+void ManyBoneIK3D::_solve_iterations(const Vector<Ref<IKBoneSegment3D>> &p_segments, const SolveSettings &p_settings) {
+	// The coarse passes solve the reduced skeleton of virtual bones, one per chain; the full iterations then refine every bone.
+	if (!p_settings.constraint_mode) {
+		for (const Ref<IKBoneSegment3D> &segmented_skeleton : p_segments) {
+			if (segmented_skeleton.is_null()) {
+				continue;
+			}
+			segmented_skeleton->coarse_solver(p_settings.bone_cos_half_damp, p_settings.default_cos_half_damp, p_settings.coarse_iterations);
+		}
+	}
+	for (int32_t i = 0; i < p_settings.iterations; i++) {
+		for (const Ref<IKBoneSegment3D> &segmented_skeleton : p_segments) {
+			if (segmented_skeleton.is_null()) {
+				continue;
+			}
+			segmented_skeleton->segment_solver(p_settings.bone_cos_half_damp, p_settings.default_cos_half_damp, p_settings.constraint_mode, i, p_settings.iterations);
+		}
+	}
+}
+
+bool ManyBoneIK3D::_is_background_solve_active() const {
+	return editor_background_solve && !deterministic && Engine::get_singleton()->is_editor_hint();
+}
+
+void ManyBoneIK3D::_background_solve_task(void *p_userdata) {
+	_solve_iterations(segmented_skeletons, background_solve_settings);
+}
+
+void ManyBoneIK3D::_wait_for_background_solve() const {
+	if (background_solve_task == WorkerThreadPool::INVALID_TASK_ID) {
+		return;
+	}
+	WorkerThreadPool::get_singleton()->wait_for_task_completion(background_solve_task);
+	background_solve_task = WorkerThreadPool::INVALID_TASK_ID;
+	background_solve_publish = true;
+}
+
+void ManyBoneIK3D::_store_published_bone_poses() {
+	Skeleton3D *skeleton = get_skeleton();
+	published_bone_ids.clear();
+	published_bone_poses.clear();
+	for (const Ref<IKBone3D> &bone : bone_list) {
+		if (bone.is_null() || bone->get_bone_id() == -1) {
+			continue;
+		}
+		published_bone_ids.push_back(bone->get_bone_id());
+		published_bone_poses.push_back(skeleton->get_bone_pose(bone->get_bone_id()));
+	}
+}
+
+void ManyBoneIK3D::_store_published_constraints() {
+	published_constraints.clear();
+	for (const Ref<IKBone3D> &bone : bone_list) {
+		if (bone.is_null() || bone->get_constraint().is_null()) {
+			continue;
+		}
+		PublishedConstraint published;
+		published.bone = bone->get_bone_id();
+		published.constraint = bone->get_constraint();
+		published.orientation = bone->get_constraint_orientation_transform()->get_global_transform();
+		published_constraints.push_back(published);
+	}
+}
+
+void ManyBoneIK3D::_apply_published_bone_poses() {
+	Skeleton3D *skeleton = get_skeleton();
+	for (uint32_t bone_i = 0; bone_i < published_bone_ids.size(); bone_i++) {
+		BoneId bone_id = published_bone_ids[bone_i];
+		if (bone_id >= skeleton->get_bone_count()) {
+			continue;
+		}
+		IKBone3D::write_skeleton_bone_pose(skeleton, bone_id, published_bone_poses[bone_i]);
 	}
-	update_gizmos();
 }
 
 void ManyBoneIK3D::_get_property_list(List<PropertyInfo> *p_list) const {
-	const Vector<Ref<IKBone3D>> ik_bones = get_bone_list();
 	RBSet<StringName> existing_pins;
 	for (int32_t pin_i = 0; pin_i < get_effector_count(); pin_i++) {
 		const String bone_name = get_effector_bone_name(pin_i);
@@ -155,6 +306,8 @@ void ManyBoneIK3D::_get_property_list(List<PropertyInfo> *p_list) const {
 				PropertyInfo(Variant::NODE_PATH, "pins/" + itos(pin_i) + "/target_node", PROPERTY_HINT_NODE_PATH_VALID_TYPES, "Node3D", pin_usage));
 		p_list->push_back(
 				PropertyInfo(Variant::BOOL, "pins/" + itos(pin_i) + "/target_static", PROPERTY_HINT_NONE, "", pin_usage));
+		p_list->push_back(
+				PropertyInfo(Variant::NODE_PATH, "pins/" + itos(pin_i) + "/pole_node", PROPERTY_HINT_NODE_PATH_VALID_TYPES, "Node3D", pin_usage));
 		p_list->push_back(
 				PropertyInfo(Variant::FLOAT, "pins/" + itos(pin_i) + "/motion_propagation_factor", PROPERTY_HINT_RANGE, "0,1,0.1,or_greater", pin_usage));
 		p_list->push_back(
@@ -196,7 +349,7 @@ void ManyBoneIK3D::_get_property_list(List<PropertyInfo> *p_list) const {
 		p_list->push_back(
 				PropertyInfo(Variant::FLOAT, "constraints/" + itos(constraint_i) + "/twist_end", PROPERTY_HINT_RANGE, "-359.9,359.9,0.1,radians,exp", constraint_usage));
 		p_list->push_back(
-				PropertyInfo(Variant::INT, "constraints/" + itos(constraint_i) + "/kusudama_open_cone_count", PROPERTY_HINT_RANGE, "0,10,1", constraint_usage | PROPERTY_USAGE_ARRAY | PROPERTY_USAGE_READ_ONLY,
+				PropertyInfo(Variant::INT, "constraints/" + itos(constraint_i) + "/kusudama_open_cone_count", PROPERTY_HINT_RANGE, "0,10,1,or_greater", constraint_usage | PROPERTY_USAGE_ARRAY | PROPERTY_USAGE_READ_ONLY,
 						"Limit Cones,constraints/" + itos(constraint_i) + "/kusudama_open_cone/"));
 		for (int cone_i = 0; cone_i < get_kusudama_open_cone_count(constraint_i); cone_i++) {
 			p_list->push_back(
@@ -240,6 +393,9 @@ bool ManyBoneIK3D::_get(const StringName &p_name, Variant &r_ret) const {
 		} else if (what == "target_static") {
 			r_ret = effector_template->get_target_node().is_empty();
 			return true;
+		} else if (what == "pole_node") {
+			r_ret = effector_template->get_pole_node();
+			return true;
 		} else if (what == "motion_propagation_factor") {
 			r_ret = get_pin_motion_propagation_factor(index);
 			return true;
@@ -318,6 +474,9 @@ bool ManyBoneIK3D::_set(const StringName &p_name, const Variant &p_value) {
 				set_effector_target_node_path(index, NodePath());
 			}
 			return true;
+		} else if (what == "pole_node") {
+			set_pin_pole_node_path(index, p_value);
+			return true;
 		} else if (what == "motion_propagation_factor") {
 			set_pin_motion_propagation_factor(index, p_value);
 			return true;
@@ -405,12 +564,16 @@ void ManyBoneIK3D::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_pin_direction_priorities", "index", "priority"), &ManyBoneIK3D::set_pin_direction_priorities);
 	ClassDB::bind_method(D_METHOD("get_effector_pin_node_path", "index"), &ManyBoneIK3D::get_effector_pin_node_path);
 	ClassDB::bind_method(D_METHOD("set_effector_pin_node_path", "index", "nodepath"), &ManyBoneIK3D::set_effector_pin_node_path);
+	ClassDB::bind_method(D_METHOD("set_pin_pole_node_path", "index", "pole_node"), &ManyBoneIK3D::set_pin_pole_node_path);
+	ClassDB::bind_method(D_METHOD("get_pin_pole_node_path", "index"), &ManyBoneIK3D::get_pin_pole_node_path);
 	ClassDB::bind_method(D_METHOD("set_pin_weight", "index", "weight"), &ManyBoneIK3D::set_pin_weight);
 	ClassDB::bind_method(D_METHOD("get_pin_weight", "index"), &ManyBoneIK3D::get_pin_weight);
 	ClassDB::bind_method(D_METHOD("get_pin_enabled", "index"), &ManyBoneIK3D::get_pin_enabled);
 	ClassDB::bind_method(D_METHOD("get_constraint_name", "index"), &ManyBoneIK3D::get_constraint_name);
 	ClassDB::bind_method(D_METHOD("get_iterations_per_frame"), &ManyBoneIK3D::get_iterations_per_frame);
 	ClassDB::bind_method(D_METHOD("set_iterations_per_frame", "count"), &ManyBoneIK3D::set_iterations_per_frame);
+	ClassDB::bind_method(D_METHOD("get_coarse_iterations"), &ManyBoneIK3D::get_coarse_iterations);
+	ClassDB::bind_method(D_METHOD("set_coarse_iterations", "count"), &ManyBoneIK3D::set_coarse_iterations);
 	ClassDB::bind_method(D_METHOD("find_constraint", "name"), &ManyBoneIK3D::find_constraint);
 	ClassDB::bind_method(D_METHOD("find_pin", "name"), &ManyBoneIK3D::find_pin);
 	ClassDB::bind_method(D_METHOD("get_constraint_count"), &ManyBoneIK3D::get_constraint_count);
@@ -424,19 +587,51 @@ void ManyBoneIK3D::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_ui_selected_bone"), &ManyBoneIK3D::get_ui_selected_bone);
 	ClassDB::bind_method(D_METHOD("set_stabilization_passes", "passes"), &ManyBoneIK3D::set_stabilization_passes);
 	ClassDB::bind_method(D_METHOD("get_stabilization_passes"), &ManyBoneIK3D::get_stabilization_passes);
+	ClassDB::bind_method(D_METHOD("sample_constraint_directions", "index", "player", "animation", "fps"), &ManyBoneIK3D::sample_constraint_directions, DEFVAL(30.0));
+	ClassDB::bind_method(D_METHOD("fit_constraint_cones", "index", "directions", "max_radius"), &ManyBoneIK3D::fit_constraint_cones);
+	ClassDB::bind_method(D_METHOD("simplify_constraint_cones", "index", "tolerance"), &ManyBoneIK3D::simplify_constraint_cones);
+	ClassDB::bind_method(D_METHOD("query_reachability", "pin_index", "targets", "iterations"), &ManyBoneIK3D::query_reachability, DEFVAL(10));
+	ClassDB::bind_method(D_METHOD("bake_animation", "player", "animation", "fps", "tolerance"), &ManyBoneIK3D::bake_animation, DEFVAL(30.0), DEFVAL(0.0));
+	ClassDB::bind_method(D_METHOD("capture_state", "state"), &ManyBoneIK3D::capture_state);
+	ClassDB::bind_method(D_METHOD("get_state"), &ManyBoneIK3D::get_state);
+	ClassDB::bind_method(D_METHOD("set_state", "state"), &ManyBoneIK3D::set_state);
+	ClassDB::bind_method(D_METHOD("set_deterministic", "enabled"), &ManyBoneIK3D::set_deterministic);
+	ClassDB::bind_method(D_METHOD("get_deterministic"), &ManyBoneIK3D::get_deterministic);
+	ClassDB::bind_method(D_METHOD("set_editor_background_solve", "enabled"), &ManyBoneIK3D::set_editor_background_solve);
+	ClassDB::bind_method(D_METHOD("get_editor_background_solve"), &ManyBoneIK3D::get_editor_background_solve);
+	ClassDB::bind_method(D_METHOD("set_analytic_short_chains", "enabled"), &ManyBoneIK3D::set_analytic_short_chains);
+	ClassDB::bind_method(D_METHOD("get_analytic_short_chains"), &ManyBoneIK3D::get_analytic_short_chains);
+	ClassDB::bind_method(D_METHOD("set_fabrik_unconstrained_chains", "enabled"), &ManyBoneIK3D::set_fabrik_unconstrained_chains);
+	ClassDB::bind_method(D_METHOD("get_fabrik_unconstrained_chains"), &ManyBoneIK3D::get_fabrik_unconstrained_chains);
+	ClassDB::bind_method(D_METHOD("set_iteration_scheme", "scheme"), &ManyBoneIK3D::set_iteration_scheme);
+	ClassDB::bind_method(D_METHOD("get_iteration_scheme"), &ManyBoneIK3D::get_iteration_scheme);
+	ClassDB::bind_method(D_METHOD("set_jacobi_relaxation", "relaxation"), &ManyBoneIK3D::set_jacobi_relaxation);
+	ClassDB::bind_method(D_METHOD("get_jacobi_relaxation"), &ManyBoneIK3D::get_jacobi_relaxation);
 	ClassDB::bind_method(D_METHOD("set_effector_bone_name", "index", "name"), &ManyBoneIK3D::set_effector_bone_name);
 
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "iterations_per_frame", PROPERTY_HINT_RANGE, "1,150,1,or_greater"), "set_iterations_per_frame", "get_iterations_per_frame");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "coarse_iterations", PROPERTY_HINT_RANGE, "0,16,1,or_greater"), "set_coarse_iterations", "get_coarse_iterations");
 	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "default_damp", PROPERTY_HINT_RANGE, "0.01,180.0,0.1,radians,exp", PROPERTY_USAGE_DEFAULT | PROPERTY_USAGE_UPDATE_ALL_IF_MODIFIED), "set_default_damp", "get_default_damp");
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "constraint_mode"), "set_constraint_mode", "get_constraint_mode");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "ui_selected_bone", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NO_EDITOR), "set_ui_selected_bone", "get_ui_selected_bone");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "stabilization_passes"), "set_stabilization_passes", "get_stabilization_passes");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "deterministic"), "set_deterministic", "get_deterministic");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "editor_background_solve"), "set_editor_background_solve", "get_editor_background_solve");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "analytic_short_chains"), "set_analytic_short_chains", "get_analytic_short_chains");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "fabrik_unconstrained_chains"), "set_fabrik_unconstrained_chains", "get_fabrik_unconstrained_chains");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "iteration_scheme", PROPERTY_HINT_ENUM, "Gauss-Seidel,Jacobi"), "set_iteration_scheme", "get_iteration_scheme");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "jacobi_relaxation", PROPERTY_HINT_RANGE, "0.01,1,0.01"), "set_jacobi_relaxation", "get_jacobi_relaxation");
+
+	BIND_ENUM_CONSTANT(ITERATION_SCHEME_GAUSS_SEIDEL);
+	BIND_ENUM_CONSTANT(ITERATION_SCHEME_JACOBI);
 }
 
 ManyBoneIK3D::ManyBoneIK3D() {
 }
 
 ManyBoneIK3D::~ManyBoneIK3D() {
+	_wait_for_background_solve();
+	_release_rigs();
 }
 
 float ManyBoneIK3D::get_pin_motion_propagation_factor(int32_t p_effector_index) const {
@@ -615,6 +810,7 @@ void ManyBoneIK3D::set_constraint_name_at_index(int32_t p_index, String p_name)
 }
 
 Vector<Ref<IKBoneSegment3D>> ManyBoneIK3D::get_segmented_skeletons() {
+	_wait_for_background_solve();
 	return segmented_skeletons;
 }
 
@@ -626,6 +822,14 @@ void ManyBoneIK3D::set_iterations_per_frame(const float &p_iterations_per_frame)
 	iterations_per_frame = p_iterations_per_frame;
 }
 
+int32_t ManyBoneIK3D::get_coarse_iterations() const {
+	return coarse_iterations;
+}
+
+void ManyBoneIK3D::set_coarse_iterations(int32_t p_coarse_iterations) {
+	coarse_iterations = MAX(p_coarse_iterations, 0);
+}
+
 void ManyBoneIK3D::set_effector_pin_node_path(int32_t p_effector_index, NodePath p_node_path) {
 	ERR_FAIL_INDEX(p_effector_index, pins.size());
 	Node *node = get_node_or_null(p_node_path);
@@ -649,6 +853,21 @@ void ManyBoneIK3D::_process_modification() {
 	if (get_effector_count() == 0) {
 		return;
 	}
+	if (background_solve_task != WorkerThreadPool::INVALID_TASK_ID) {
+		if (!WorkerThreadPool::get_singleton()->is_task_completed(background_solve_task)) {
+			// The skeleton restores its pose after every update, so keep showing the last finished solve.
+			_apply_published_bone_poses();
+			return;
+		}
+		_wait_for_background_solve();
+	}
+	if (background_solve_publish) {
+		background_solve_publish = false;
+		_update_skeleton_bones_transform();
+		_store_published_bone_poses();
+		// Launch the next solve on the following frame, so the gizmo redraw queued above never reads bones that are being solved.
+		return;
+	}
 	if (!segmented_skeletons.size()) {
 		set_dirty();
 	}
@@ -682,15 +901,365 @@ void ManyBoneIK3D::_process_modification() {
 	if (!is_visible()) {
 		return;
 	}
-	for (int32_t i = 0; i < get_iterations_per_frame(); i++) {
-		for (Ref<IKBoneSegment3D> segmented_skeleton : segmented_skeletons) {
-			if (segmented_skeleton.is_null()) {
-				continue;
+	if (deterministic) {
+		// Start from this frame's input pose instead of the previous result, so the output only depends on the current inputs.
+		_update_ik_bones_transform();
+	}
+	if (_is_background_solve_active()) {
+		// Latest wins: edits made while a solve runs only touch the targets and settings, which are snapshotted here for the next one.
+		_update_effector_targets();
+		_apply_published_bone_poses();
+		background_solve_settings = _get_solve_settings();
+		keep_restored_targets = false;
+		background_solve_task = WorkerThreadPool::get_singleton()->add_template_task(this, &ManyBoneIK3D::_background_solve_task, nullptr, false, "ManyBoneIK3D editor solve");
+		return;
+	}
+	_solve_iterations(segmented_skeletons, _get_solve_settings());
+	keep_restored_targets = false;
+	_update_skeleton_bones_transform();
+}
+
+PackedVector3Array ManyBoneIK3D::sample_constraint_directions(int32_t p_constraint_index, AnimationPlayer *p_player, const StringName &p_animation, float p_fps) {
+	ERR_FAIL_INDEX_V(p_constraint_index, constraint_names.size(), PackedVector3Array());
+	ERR_FAIL_NULL_V(p_player, PackedVector3Array());
+	ERR_FAIL_COND_V_MSG(p_fps <= 0.0f, PackedVector3Array(), "The sample rate must be greater than zero.");
+	Skeleton3D *skeleton = get_skeleton();
+	ERR_FAIL_NULL_V(skeleton, PackedVector3Array());
+	Ref<Animation> source = p_player->get_animation(p_animation);
+	ERR_FAIL_COND_V_MSG(source.is_null(), PackedVector3Array(), vformat("Animation \"%s\" not found.", p_animation));
+
+	_wait_for_background_solve();
+	if (is_dirty || !segmented_skeletons.size()) {
+		is_dirty = false;
+		_bone_list_changed();
+	}
+	BoneId bone_id = skeleton->find_bone(constraint_names[p_constraint_index]);
+	Ref<IKBone3D> ik_bone;
+	for (const Ref<IKBone3D> &bone : bone_list) {
+		if (bone->get_bone_id() == bone_id) {
+			ik_bone = bone;
+			break;
+		}
+	}
+	ERR_FAIL_COND_V_MSG(ik_bone.is_null() || ik_bone->get_parent().is_null(), PackedVector3Array(), vformat("Constraint %d is not on a solved bone with a parent.", p_constraint_index));
+
+	PackedVector3Array directions;
+	String previous_animation = p_player->get_assigned_animation();
+	double previous_position = previous_animation.is_empty() ? 0.0 : p_player->get_current_animation_position();
+	p_player->set_assigned_animation(p_animation);
+	int32_t frame_count = int32_t(Math::floor(source->get_length() * p_fps)) + 1;
+	for (int32_t frame_i = 0; frame_i < frame_count; frame_i++) {
+		p_player->seek(MIN(frame_i / double(p_fps), source->get_length()), true);
+		_update_ik_bones_transform();
+		// The same bone tip the orientation snap tests against the cones.
+		Vector3 direction = ik_bone->get_constraint_orientation_transform()->to_local(ik_bone->get_bone_direction_transform()->get_global_transform().xform(Vector3(0.0, 1.0, 0.0)));
+		if (!direction.is_zero_approx()) {
+			directions.push_back(direction.normalized());
+		}
+	}
+	if (!previous_animation.is_empty()) {
+		p_player->set_assigned_animation(previous_animation);
+		p_player->seek(previous_position, true);
+	}
+	_update_ik_bones_transform();
+	return directions;
+}
+
+Dictionary ManyBoneIK3D::fit_constraint_cones(int32_t p_constraint_index, const PackedVector3Array &p_directions, float p_max_radius) {
+	ERR_FAIL_INDEX_V(p_constraint_index, kusudama_open_cones.size(), Dictionary());
+	ERR_FAIL_COND_V_MSG(p_directions.is_empty(), Dictionary(), "Fitting cones needs at least one direction.");
+	ERR_FAIL_COND_V_MSG(p_max_radius <= 0.0f, Dictionary(), "The cone radius must be greater than zero.");
+	return _set_constraint_cones(p_constraint_index, IKKusudama3D::fit_open_cones(p_directions, p_max_radius));
+}
+
+Dictionary ManyBoneIK3D::simplify_constraint_cones(int32_t p_constraint_index, float p_tolerance) {
+	ERR_FAIL_INDEX_V(p_constraint_index, kusudama_open_cones.size(), Dictionary());
+	Vector<Vector4> cones = kusudama_open_cones[p_constraint_index];
+	cones.resize(MIN(cones.size(), kusudama_open_cone_count[p_constraint_index]));
+	return _set_constraint_cones(p_constraint_index, IKKusudama3D::simplify_open_cones(cones, MAX(p_tolerance, 0.0f)));
+}
+
+Dictionary ManyBoneIK3D::_set_constraint_cones(int32_t p_constraint_index, const Vector<Vector4> &p_cones) {
+	int32_t previous_count = kusudama_open_cone_count[p_constraint_index];
+	kusudama_open_cones.write[p_constraint_index] = p_cones;
+	kusudama_open_cone_count.write[p_constraint_index] = p_cones.size();
+	notify_property_list_changed();
+	set_dirty();
+
+	// A limit query tests every cone, then the tangent path between each consecutive pair.
+	Dictionary report;
+	report["previous_cone_count"] = previous_count;
+	report["cone_count"] = p_cones.size();
+	report["relative_cost"] = previous_count > 0 ? real_t(MAX(2 * p_cones.size() - 1, 0)) / real_t(2 * previous_count - 1) : 1.0;
+	return report;
+}
+
+PackedVector2Array ManyBoneIK3D::query_reachability(int32_t p_pin_index, const PackedVector3Array &p_targets, int32_t p_iterations) {
+	// Settings and the rig are only read once no background solve can be using them.
+	_wait_for_background_solve();
+	ERR_FAIL_INDEX_V(p_pin_index, pins.size(), PackedVector2Array());
+	ERR_FAIL_COND_V_MSG(p_iterations <= 0, PackedVector2Array(), "The query needs at least one iteration.");
+	Skeleton3D *skeleton = get_skeleton();
+	ERR_FAIL_NULL_V(skeleton, PackedVector2Array());
+	if (p_targets.is_empty()) {
+		return PackedVector2Array();
+	}
+
+	if (is_dirty || !segmented_skeletons.size()) {
+		is_dirty = false;
+		_bone_list_changed();
+	}
+	ReachabilityQuery query;
+	BoneId pinned_bone_id = skeleton->find_bone(get_effector_bone_name(p_pin_index));
+	for (int32_t bone_i = 0; bone_i < bone_list.size(); bone_i++) {
+		if (bone_list[bone_i]->get_bone_id() == pinned_bone_id && bone_list[bone_i]->is_pinned()) {
+			query.pinned_bone = bone_i;
+			break;
+		}
+	}
+	ERR_FAIL_COND_V_MSG(query.pinned_bone == -1, PackedVector2Array(), vformat("Pin %d is not part of the solved rig.", p_pin_index));
+
+	// Scratch rigs are built here because they read the skeleton, then reused until the bone list changes.
+	query.rig_count = MIN(uint32_t(p_targets.size()), uint32_t(MAX(WorkerThreadPool::get_singleton()->get_thread_count(), 1)));
+	while (query_rigs.size() < query.rig_count) {
+		QueryRig rig;
+		_build_rig(rig.segments, rig.bones, rig.origin);
+		ERR_FAIL_COND_V(rig.bones.size() != bone_list.size(), PackedVector2Array());
+		query_rigs.push_back(rig);
+	}
+
+	// Snapshot the live rig once; the workers only read these copies and never touch bone_list.
+	query.settings = _get_solve_settings();
+	query.settings.iterations = p_iterations;
+	query.settings.coarse_iterations = 0;
+	query.bone_poses.resize(bone_list.size());
+	query.effector_targets.resize(bone_list.size());
+	for (int32_t bone_i = 0; bone_i < bone_list.size(); bone_i++) {
+		const Ref<IKBone3D> &bone = bone_list[bone_i];
+		query.bone_poses[bone_i] = bone->get_pose();
+		if (bone->is_pinned()) {
+			query.effector_targets[bone_i] = bone->get_pin()->get_target_global_transform();
+		}
+	}
+	Transform3D skeleton_global_inverse = skeleton->get_global_transform().affine_inverse();
+	query.targets.resize(p_targets.size());
+	for (int32_t target_i = 0; target_i < p_targets.size(); target_i++) {
+		query.targets[target_i] = skeleton_global_inverse.xform(p_targets[target_i]);
+	}
+	PackedVector2Array results;
+	results.resize(p_targets.size());
+	query.results = results.ptrw();
+
+	WorkerThreadPool::GroupID group = WorkerThreadPool::get_singleton()->add_template_group_task(this, &ManyBoneIK3D::_query_reachability_chunk, &query, query.rig_count, query.rig_count, true, "ManyBoneIK3D reachability query");
+	WorkerThreadPool::get_singleton()->wait_for_group_task_completion(group);
+	return results;
+}
+
+void ManyBoneIK3D::_query_reachability_chunk(uint32_t p_rig_index, ReachabilityQuery *p_query) {
+	QueryRig &rig = query_rigs[p_rig_index];
+	const Ref<IKBone3D> &pinned_bone = rig.bones[p_query->pinned_bone];
+	for (uint32_t target_i = p_rig_index; target_i < p_query->targets.size(); target_i += p_query->rig_count) {
+		for (int32_t bone_i = 0; bone_i < rig.bones.size(); bone_i++) {
+			const Ref<IKBone3D> &bone = rig.bones[bone_i];
+			bone->set_pose(p_query->bone_poses[bone_i]);
+			if (bone->is_pinned()) {
+				bone->get_pin()->set_target_global_transform(p_query->effector_targets[bone_i]);
 			}
-			segmented_skeleton->segment_solver(bone_damp, get_default_damp(), get_constraint_mode(), i, get_iterations_per_frame());
+		}
+		Transform3D target = p_query->effector_targets[p_query->pinned_bone];
+		target.origin = p_query->targets[target_i];
+		pinned_bone->get_pin()->set_target_global_transform(target);
+		_solve_iterations(rig.segments, p_query->settings);
+		real_t error = pinned_bone->get_bone_direction_global_pose().origin.distance_to(target.origin);
+		p_query->results[target_i] = Vector2(error, _get_limit_saturation(pinned_bone));
+	}
+}
+
+real_t ManyBoneIK3D::_get_limit_saturation(const Ref<IKBone3D> &p_tip) {
+	int32_t constrained_count = 0;
+	int32_t saturated_count = 0;
+	for (Ref<IKBone3D> bone = p_tip; bone.is_valid(); bone = bone->get_parent()) {
+		Ref<IKKusudama3D> constraint = bone->get_constraint();
+		if (constraint.is_null() || !bone->is_orientationally_constrained() || bone->get_parent().is_null()) {
+			continue;
+		}
+		constrained_count++;
+		Ref<IKNode3D> limiting_axes = bone->get_constraint_orientation_transform();
+		Vector3 bone_tip = limiting_axes->to_local(bone->get_bone_direction_transform()->get_global_transform().xform(Vector3(0.0, 1.0, 0.0)));
+		// The tangent path test accepts directions a few thousandths of a radian past a path, so probe further out than that.
+		if (constraint->is_at_orientation_limit(bone_tip, 1.0e-2)) {
+			saturated_count++;
+		}
+	}
+	if (constrained_count == 0) {
+		return 0.0;
+	}
+	return real_t(saturated_count) / real_t(constrained_count);
+}
+
+static void _reset_previous_deviations(const Ref<IKBoneSegment3D> &p_segment) {
+	if (p_segment.is_null()) {
+		return;
+	}
+	p_segment->set_previous_deviation(INFINITY);
+	for (const Ref<IKBoneSegment3D> &child : p_segment->get_child_segments()) {
+		_reset_previous_deviations(child);
+	}
+}
+
+Ref<Animation> ManyBoneIK3D::bake_animation(AnimationPlayer *p_player, const StringName &p_animation, float p_fps, float p_tolerance) {
+	ERR_FAIL_NULL_V(p_player, Ref<Animation>());
+	ERR_FAIL_COND_V_MSG(p_fps <= 0.0f, Ref<Animation>(), "The bake rate must be greater than zero.");
+	Skeleton3D *skeleton = get_skeleton();
+	ERR_FAIL_NULL_V(skeleton, Ref<Animation>());
+	Ref<Animation> source = p_player->get_animation(p_animation);
+	ERR_FAIL_COND_V_MSG(source.is_null(), Ref<Animation>(), vformat("Animation \"%s\" not found.", p_animation));
+	Node *player_root = p_player->get_node_or_null(p_player->get_root_node());
+	ERR_FAIL_NULL_V(player_root, Ref<Animation>());
+	ERR_FAIL_NULL_V_MSG(p_player->get_parent(), Ref<Animation>(), "The player must be inside a scene to bake from it.");
+
+	_wait_for_background_solve();
+	if (is_dirty || !segmented_skeletons.size()) {
+		is_dirty = false;
+		_bone_list_changed();
+	}
+	ERR_FAIL_COND_V(bone_list.is_empty(), Ref<Animation>());
+	// Every frame reads its targets from the scene, and the live rig is read back afterwards, so a restored state does not survive a bake.
+	keep_restored_targets = false;
+
+	Ref<Animation> baked;
+	baked.instantiate();
+	baked->set_length(source->get_length());
+	baked->set_loop_mode(source->get_loop_mode());
+	baked->set_step(1.0 / p_fps);
+	String skeleton_path = player_root->get_path_to(skeleton);
+	LocalVector<int32_t> position_tracks;
+	LocalVector<int32_t> rotation_tracks;
+	for (const Ref<IKBone3D> &bone : bone_list) {
+		NodePath track_path = skeleton_path + ":" + skeleton->get_bone_name(bone->get_bone_id());
+		int32_t position_track = baked->add_track(Animation::TYPE_POSITION_3D);
+		baked->track_set_path(position_track, track_path);
+		position_tracks.push_back(position_track);
+		int32_t rotation_track = baked->add_track(Animation::TYPE_ROTATION_3D);
+		baked->track_set_path(rotation_track, track_path);
+		rotation_tracks.push_back(rotation_track);
+	}
+
+	// Seek a scratch player that shares the libraries, so the caller's player keeps its assigned animation and position.
+	AnimationPlayer *scratch_player = memnew(AnimationPlayer);
+	scratch_player->set_callback_mode_process(AnimationMixer::ANIMATION_CALLBACK_MODE_PROCESS_MANUAL);
+	List<StringName> libraries;
+	p_player->get_animation_library_list(&libraries);
+	for (const StringName &library : libraries) {
+		scratch_player->add_animation_library(library, p_player->get_animation_library(library));
+	}
+	p_player->get_parent()->add_child(scratch_player);
+	scratch_player->set_root_node(scratch_player->get_path_to(player_root));
+	scratch_player->set_assigned_animation(p_animation);
+
+	// Seeking moves the skeleton and the pin targets, so keep what they showed before to put back afterwards.
+	LocalVector<Transform3D> skeleton_poses;
+	skeleton_poses.resize(skeleton->get_bone_count());
+	for (int32_t bone_i = 0; bone_i < skeleton->get_bone_count(); bone_i++) {
+		skeleton_poses[bone_i] = skeleton->get_bone_pose(bone_i);
+	}
+	LocalVector<Node3D *> target_nodes;
+	LocalVector<Transform3D> target_transforms;
+	for (const Ref<IKBone3D> &bone : bone_list) {
+		Node3D *target_node = bone->is_pinned() ? cast_to<Node3D>(get_node_or_null(bone->get_pin()->get_target_node())) : nullptr;
+		if (target_node) {
+			target_nodes.push_back(target_node);
+			target_transforms.push_back(target_node->get_transform());
+		}
+	}
+
+	// Seeking drives the one live skeleton, so read every frame's input here and solve the frames in parallel afterwards.
+	BakeQuery bake;
+	bake.settings = _get_solve_settings();
+	bake.bone_count = bone_list.size();
+	bake.frame_count = uint32_t(Math::floor(source->get_length() * p_fps)) + 1;
+	bake.input_poses.resize(bake.frame_count * bake.bone_count);
+	bake.effector_targets.resize(bake.frame_count * bake.bone_count);
+	for (uint32_t frame_i = 0; frame_i < bake.frame_count; frame_i++) {
+		scratch_player->seek(MIN(frame_i / double(p_fps), source->get_length()), true);
+		_update_ik_bones_transform();
+		for (uint32_t bone_i = 0; bone_i < bake.bone_count; bone_i++) {
+			const Ref<IKBone3D> &bone = bone_list[bone_i];
+			bake.input_poses[frame_i * bake.bone_count + bone_i] = bone->get_pose();
+			if (bone->is_pinned()) {
+				bake.effector_targets[frame_i * bake.bone_count + bone_i] = bone->get_pin()->get_target_global_transform();
+			}
+		}
+	}
+	p_player->get_parent()->remove_child(scratch_player);
+	memdelete(scratch_player);
+	for (uint32_t target_i = 0; target_i < target_nodes.size(); target_i++) {
+		target_nodes[target_i]->set_transform(target_transforms[target_i]);
+	}
+	for (uint32_t bone_i = 0; bone_i < skeleton_poses.size(); bone_i++) {
+		IKBone3D::write_skeleton_bone_pose(skeleton, bone_i, skeleton_poses[bone_i]);
+	}
+	_update_ik_bones_transform();
+
+	// An inactive modifier leaves the animation as it is, the same as it would at runtime.
+	bake.solved_poses = bake.input_poses;
+	if (is_active()) {
+		bake.rig_count = MIN(bake.frame_count, uint32_t(MAX(WorkerThreadPool::get_singleton()->get_thread_count(), 1)));
+		while (query_rigs.size() < bake.rig_count) {
+			QueryRig rig;
+			_build_rig(rig.segments, rig.bones, rig.origin);
+			ERR_FAIL_COND_V(rig.bones.size() != bone_list.size(), Ref<Animation>());
+			query_rigs.push_back(rig);
+		}
+		WorkerThreadPool::GroupID group = WorkerThreadPool::get_singleton()->add_template_group_task(this, &ManyBoneIK3D::_bake_animation_chunk, &bake, bake.rig_count, bake.rig_count, true, "ManyBoneIK3D animation bake");
+		WorkerThreadPool::get_singleton()->wait_for_group_task_completion(group);
+	}
+
+	// Blend like Skeleton3D::_process_modifiers does for a modifier with less than full influence.
+	const real_t influence = get_influence();
+	for (uint32_t frame_i = 0; frame_i < bake.frame_count; frame_i++) {
+		double time = MIN(frame_i / double(p_fps), source->get_length());
+		for (uint32_t bone_i = 0; bone_i < bake.bone_count; bone_i++) {
+			const Transform3D &input_pose = bake.input_poses[frame_i * bake.bone_count + bone_i];
+			Transform3D pose = bake.solved_poses[frame_i * bake.bone_count + bone_i];
+			if (!pose.basis.is_finite()) {
+				pose.basis = Basis();
+			}
+			if (influence < 1.0 && pose != input_pose) {
+				pose = input_pose.interpolate_with(pose, influence);
+			}
+			baked->position_track_insert_key(position_tracks[bone_i], time, pose.origin);
+			baked->rotation_track_insert_key(rotation_tracks[bone_i], time, pose.basis.get_rotation_quaternion());
+		}
+	}
+	if (p_tolerance > 0.0f) {
+		baked->optimize(p_tolerance, p_tolerance);
+	}
+	return baked;
+}
+
+void ManyBoneIK3D::_bake_animation_chunk(uint32_t p_rig_index, BakeQuery *p_query) {
+	QueryRig &rig = query_rigs[p_rig_index];
+	const uint32_t frame_begin = p_query->frame_count * p_rig_index / p_query->rig_count;
+	const uint32_t frame_end = p_query->frame_count * (p_rig_index + 1) / p_query->rig_count;
+	for (uint32_t frame_i = frame_begin; frame_i < frame_end; frame_i++) {
+		const uint32_t frame_offset = frame_i * p_query->bone_count;
+		for (uint32_t bone_i = 0; bone_i < p_query->bone_count; bone_i++) {
+			const Ref<IKBone3D> &bone = rig.bones[bone_i];
+			bone->set_pose(p_query->input_poses[frame_offset + bone_i]);
+			if (bone->is_pinned()) {
+				bone->get_pin()->set_target_global_transform(p_query->effector_targets[frame_offset + bone_i]);
+			}
+		}
+		// Every frame starts from its own input pose, so no score carries over and the result does not depend on the chunking.
+		for (const Ref<IKBoneSegment3D> &segment : rig.segments) {
+			_reset_previous_deviations(segment);
+		}
+		_solve_iterations(rig.segments, p_query->settings);
+		for (uint32_t bone_i = 0; bone_i < p_query->bone_count; bone_i++) {
+			p_query->solved_poses[frame_offset + bone_i] = rig.bones[bone_i]->get_pose();
 		}
 	}
-	_update_skeleton_bones_transform();
 }
 
 real_t ManyBoneIK3D::get_pin_weight(int32_t p_pin_index) const {
@@ -768,10 +1337,16 @@ int32_t ManyBoneIK3D::get_bone_count() const {
 }
 
 Vector<Ref<IKBone3D>> ManyBoneIK3D::get_bone_list() const {
+	_wait_for_background_solve();
 	return bone_list;
 }
 
+const LocalVector<ManyBoneIK3D::PublishedConstraint> &ManyBoneIK3D::get_published_constraints() const {
+	return published_constraints;
+}
+
 void ManyBoneIK3D::set_direction_transform_of_bone(int32_t p_index, Transform3D p_transform) {
+	_wait_for_background_solve();
 	ERR_FAIL_INDEX(p_index, constraint_names.size());
 	if (!get_skeleton()) {
 		return;
@@ -795,6 +1370,7 @@ void ManyBoneIK3D::set_direction_transform_of_bone(int32_t p_index, Transform3D
 }
 
 Transform3D ManyBoneIK3D::get_direction_transform_of_bone(int32_t p_index) const {
+	_wait_for_background_solve();
 	if (p_index < 0 || p_index >= constraint_names.size() || get_skeleton() == nullptr) {
 		return Transform3D();
 	}
@@ -815,6 +1391,7 @@ Transform3D ManyBoneIK3D::get_direction_transform_of_bone(int32_t p_index) const
 }
 
 Transform3D ManyBoneIK3D::get_orientation_transform_of_constraint(int32_t p_index) const {
+	_wait_for_background_solve();
 	ERR_FAIL_INDEX_V(p_index, constraint_names.size(), Transform3D());
 	String bone_name = constraint_names[p_index];
 	if (!segmented_skeletons.size()) {
@@ -840,6 +1417,7 @@ Transform3D ManyBoneIK3D::get_orientation_transform_of_constraint(int32_t p_inde
 }
 
 void ManyBoneIK3D::set_orientation_transform_of_constraint(int32_t p_index, Transform3D p_transform) {
+	_wait_for_background_solve();
 	ERR_FAIL_INDEX(p_index, constraint_names.size());
 	String bone_name = constraint_names[p_index];
 	if (!get_skeleton()) {
@@ -862,6 +1440,7 @@ void ManyBoneIK3D::set_orientation_transform_of_constraint(int32_t p_index, Tran
 }
 
 Transform3D ManyBoneIK3D::get_twist_transform_of_constraint(int32_t p_index) const {
+	_wait_for_background_solve();
 	ERR_FAIL_INDEX_V(p_index, constraint_names.size(), Transform3D());
 	String bone_name = constraint_names[p_index];
 	if (!segmented_skeletons.size()) {
@@ -887,6 +1466,7 @@ Transform3D ManyBoneIK3D::get_twist_transform_of_constraint(int32_t p_index) con
 }
 
 void ManyBoneIK3D::set_twist_transform_of_constraint(int32_t p_index, Transform3D p_transform) {
+	_wait_for_background_solve();
 	ERR_FAIL_INDEX(p_index, constraint_names.size());
 	String bone_name = constraint_names[p_index];
 	if (!get_skeleton()) {
@@ -964,10 +1544,142 @@ int32_t ManyBoneIK3D::get_stabilization_passes() {
 	return stabilize_passes;
 }
 
+static void _capture_previous_deviations(const Ref<IKBoneSegment3D> &p_segment, LocalVector<ik_real_t> &r_deviations) {
+	if (p_segment.is_null()) {
+		return;
+	}
+	r_deviations.push_back(p_segment->get_previous_deviation());
+	for (const Ref<IKBoneSegment3D> &child : p_segment->get_child_segments()) {
+		_capture_previous_deviations(child, r_deviations);
+	}
+}
+
+static void _restore_previous_deviations(const Ref<IKBoneSegment3D> &p_segment, const LocalVector<ik_real_t> &p_deviations, uint32_t &r_index) {
+	if (p_segment.is_null() || r_index >= p_deviations.size()) {
+		return;
+	}
+	p_segment->set_previous_deviation(p_deviations[r_index++]);
+	for (const Ref<IKBoneSegment3D> &child : p_segment->get_child_segments()) {
+		_restore_previous_deviations(child, p_deviations, r_index);
+	}
+}
+
+void ManyBoneIK3D::capture_state_data(ManyBoneIK3DStateData &r_state) const {
+	_wait_for_background_solve();
+	r_state.clear();
+	for (const Ref<IKBone3D> &bone : bone_list) {
+		r_state.bone_ids.push_back(bone->get_bone_id());
+		r_state.bone_poses.push_back(bone->get_pose());
+		if (bone->is_pinned()) {
+			r_state.effector_targets.push_back(bone->get_pin()->get_target_global_transform());
+		}
+	}
+	for (const Ref<IKBoneSegment3D> &segmented_skeleton : segmented_skeletons) {
+		_capture_previous_deviations(segmented_skeleton, r_state.previous_deviations);
+	}
+}
+
+void ManyBoneIK3D::set_state_data(const ManyBoneIK3DStateData &p_state) {
+	_wait_for_background_solve();
+	ERR_FAIL_COND_MSG(p_state.bone_ids.size() != (uint32_t)bone_list.size(), "The state was captured from a different rig.");
+	for (int32_t bone_i = 0; bone_i < bone_list.size(); bone_i++) {
+		ERR_FAIL_COND_MSG(p_state.bone_ids[bone_i] != bone_list[bone_i]->get_bone_id(), "The state was captured from a different rig.");
+	}
+	// Only the solver's own copy is restored. The skeleton is written by the next _process_modification, like any solve.
+	uint32_t effector_i = 0;
+	for (int32_t bone_i = 0; bone_i < bone_list.size(); bone_i++) {
+		const Ref<IKBone3D> &bone = bone_list[bone_i];
+		bone->set_pose(p_state.bone_poses[bone_i]);
+		if (bone->is_pinned() && effector_i < p_state.effector_targets.size()) {
+			bone->get_pin()->set_target_global_transform(p_state.effector_targets[effector_i++]);
+		}
+	}
+	uint32_t deviation_i = 0;
+	for (const Ref<IKBoneSegment3D> &segmented_skeleton : segmented_skeletons) {
+		_restore_previous_deviations(segmented_skeleton, p_state.previous_deviations, deviation_i);
+	}
+	// Keep the restored targets until the next solve has used them, instead of reading them back from the target nodes.
+	keep_restored_targets = true;
+}
+
+void ManyBoneIK3D::capture_state(Ref<ManyBoneIK3DState> r_state) const {
+	ERR_FAIL_COND(r_state.is_null());
+	capture_state_data(r_state->get_data());
+}
+
+Ref<ManyBoneIK3DState> ManyBoneIK3D::get_state() const {
+	Ref<ManyBoneIK3DState> state;
+	state.instantiate();
+	capture_state(state);
+	return state;
+}
+
+void ManyBoneIK3D::set_state(Ref<ManyBoneIK3DState> p_state) {
+	ERR_FAIL_COND(p_state.is_null());
+	set_state_data(p_state->get_data());
+}
+
+void ManyBoneIK3D::set_deterministic(bool p_enabled) {
+	deterministic = p_enabled;
+	set_dirty();
+}
+
+bool ManyBoneIK3D::get_deterministic() const {
+	return deterministic;
+}
+
+void ManyBoneIK3D::set_editor_background_solve(bool p_enabled) {
+	editor_background_solve = p_enabled;
+}
+
+bool ManyBoneIK3D::get_editor_background_solve() const {
+	return editor_background_solve;
+}
+
+void ManyBoneIK3D::set_analytic_short_chains(bool p_enabled) {
+	analytic_short_chains = p_enabled;
+	set_dirty();
+}
+
+bool ManyBoneIK3D::get_analytic_short_chains() const {
+	return analytic_short_chains;
+}
+
+void ManyBoneIK3D::set_fabrik_unconstrained_chains(bool p_enabled) {
+	fabrik_unconstrained_chains = p_enabled;
+	set_dirty();
+}
+
+bool ManyBoneIK3D::get_fabrik_unconstrained_chains() const {
+	return fabrik_unconstrained_chains;
+}
+
+void ManyBoneIK3D::set_iteration_scheme(IterationScheme p_scheme) {
+	iteration_scheme = p_scheme;
+	set_dirty();
+}
+
+ManyBoneIK3D::IterationScheme ManyBoneIK3D::get_iteration_scheme() const {
+	return iteration_scheme;
+}
+
+void ManyBoneIK3D::set_jacobi_relaxation(float p_relaxation) {
+	jacobi_relaxation = CLAMP(p_relaxation, 0.01f, 1.0f);
+	set_dirty();
+}
+
+float ManyBoneIK3D::get_jacobi_relaxation() const {
+	return jacobi_relaxation;
+}
+
 Transform3D ManyBoneIK3D::get_godot_skeleton_transform_inverse() {
 	return godot_skeleton_transform_inverse;
 }
 
+IKNode3DPool *ManyBoneIK3D::get_node_pool() {
+	return &node_pool;
+}
+
 Ref<IKNode3D> ManyBoneIK3D::get_godot_skeleton_transform() {
 	return godot_skeleton_transform;
 }
@@ -1009,35 +1721,75 @@ void ManyBoneIK3D::set_effector_target_fixed(int32_t p_effector_index, bool p_fo
 }
 
 void ManyBoneIK3D::_bone_list_changed() {
+	_wait_for_background_solve();
+	background_solve_publish = false;
+	published_bone_ids.clear();
+	published_bone_poses.clear();
+	published_constraints.clear();
+	keep_restored_targets = false;
+	_release_rigs();
 	Skeleton3D *skeleton = get_skeleton();
-	Vector<int32_t> roots = skeleton->get_parentless_bones();
-	if (roots.is_empty()) {
+	if (skeleton->get_parentless_bones().is_empty()) {
 		return;
 	}
-	bone_list.clear();
-	segmented_skeletons.clear();
+	_update_damp_schedule();
+	_build_rig(segmented_skeletons, bone_list, ik_origin);
+}
+
+void ManyBoneIK3D::_update_damp_schedule() {
+	// Damping settings all mark the rig dirty, so this runs once per change rather than per bone per iteration.
+	default_cos_half_damp = Math::cos(get_default_damp() / 2.0);
+	bone_cos_half_damp.resize(bone_damp.size());
+	ik_real_t *cos_half_damp = bone_cos_half_damp.ptrw();
+	for (int32_t bone_i = 0; bone_i < bone_damp.size(); bone_i++) {
+		cos_half_damp[bone_i] = Math::cos(MIN(bone_damp[bone_i], get_default_damp()) / 2.0);
+	}
+}
+
+void ManyBoneIK3D::_release_rig(Vector<Ref<IKBoneSegment3D>> &r_segments, Vector<Ref<IKBone3D>> &r_bones, Ref<IKNode3D> &r_origin) {
+	for (Ref<IKBoneSegment3D> &segment : r_segments) {
+		segment->release();
+	}
+	r_segments.clear();
+	r_bones.clear();
+	r_origin.unref();
+}
+
+void ManyBoneIK3D::_release_rigs() {
+	for (QueryRig &rig : query_rigs) {
+		_release_rig(rig.segments, rig.bones, rig.origin);
+	}
+	query_rigs.clear();
+	_release_rig(segmented_skeletons, bone_list, ik_origin);
+	node_pool.reclaim();
+}
+
+void ManyBoneIK3D::_build_rig(Vector<Ref<IKBoneSegment3D>> &r_segments, Vector<Ref<IKBone3D>> &r_bones, Ref<IKNode3D> &r_origin) {
+	Skeleton3D *skeleton = get_skeleton();
+	Vector<int32_t> roots = skeleton->get_parentless_bones();
 	for (BoneId root_bone_index : roots) {
 		String parentless_bone = skeleton->get_bone_name(root_bone_index);
 		Ref<IKBoneSegment3D> segmented_skeleton = Ref<IKBoneSegment3D>(memnew(IKBoneSegment3D(skeleton, parentless_bone, pins, this, nullptr, root_bone_index, -1, stabilize_passes)));
-		ik_origin.instantiate();
-		segmented_skeleton->get_root()->get_ik_transform()->set_parent(ik_origin);
+		r_origin = node_pool.acquire();
+		segmented_skeleton->get_root()->get_ik_transform()->set_parent(r_origin);
 		segmented_skeleton->generate_default_segments(pins, root_bone_index, -1, this);
 		Vector<Ref<IKBone3D>> new_bone_list;
 		segmented_skeleton->create_bone_list(new_bone_list, true);
-		bone_list.append_array(new_bone_list);
-		Vector<Vector<double>> weight_array;
+		r_bones.append_array(new_bone_list);
+		Vector<Vector<ik_real_t>> weight_array;
 		segmented_skeleton->update_pinned_list(weight_array);
 		segmented_skeleton->recursive_create_headings_arrays_for(segmented_skeleton);
-		segmented_skeletons.push_back(segmented_skeleton);
+		segmented_skeleton->build_coarse_skeleton(&node_pool);
+		r_segments.push_back(segmented_skeleton);
 	}
-	_update_ik_bones_transform();
-	for (Ref<IKBone3D> &ik_bone_3d : bone_list) {
+	_read_rig_pose(r_bones);
+	for (Ref<IKBone3D> &ik_bone_3d : r_bones) {
 		ik_bone_3d->update_default_bone_direction_transform(skeleton);
 	}
 	for (int constraint_i = 0; constraint_i < constraint_count; ++constraint_i) {
 		String bone = constraint_names[constraint_i];
 		BoneId bone_id = skeleton->find_bone(bone);
-		for (Ref<IKBone3D> &ik_bone_3d : bone_list) {
+		for (Ref<IKBone3D> &ik_bone_3d : r_bones) {
 			if (ik_bone_3d->get_bone_id() != bone_id) {
 				continue;
 			}
@@ -1065,6 +1817,10 @@ void ManyBoneIK3D::_bone_list_changed() {
 			break;
 		}
 	}
+	// The engine choice depends on which bones ended up constrained.
+	for (const Ref<IKBoneSegment3D> &segment : r_segments) {
+		segment->update_solver_engines();
+	}
 }
 
 void ManyBoneIK3D::_skeleton_changed(Skeleton3D *p_old, Skeleton3D *p_new) {
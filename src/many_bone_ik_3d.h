@@ -35,18 +35,41 @@
 #include "core/math/transform_3d.h"
 #include "core/math/vector3.h"
 #include "core/object/ref_counted.h"
+#include "core/object/worker_thread_pool.h"
+#include "core/templates/local_vector.h"
 #include "ik_bone_3d.h"
 #include "ik_effector_template_3d.h"
 #include "math/ik_node_3d.h"
 #include "scene/3d/skeleton_3d.h"
 #include "scene/3d/skeleton_modifier_3d.h"
+#include "scene/resources/animation.h"
 #include "scene/main/scene_tree.h"
 
+class AnimationPlayer;
 class ManyBoneIK3DState;
+struct ManyBoneIK3DStateData;
 class ManyBoneIK3D : public SkeletonModifier3D {
 	GDCLASS(ManyBoneIK3D, SkeletonModifier3D);
+	friend class ManyBoneIK3DRegressionRunner;
 
+public:
+	enum IterationScheme {
+		ITERATION_SCHEME_GAUSS_SEIDEL,
+		ITERATION_SCHEME_JACOBI,
+	};
+	// A constraint frame as of the last finished solve, for drawing while the next one runs.
+	struct PublishedConstraint {
+		BoneId bone = -1;
+		Ref<IKKusudama3D> constraint;
+		Transform3D orientation;
+	};
+
+private:
 	bool is_constraint_mode = false;
+	bool analytic_short_chains = false;
+	bool fabrik_unconstrained_chains = false;
+	IterationScheme iteration_scheme = ITERATION_SCHEME_GAUSS_SEIDEL;
+	float jacobi_relaxation = 1.0f;
 	NodePath skeleton_path;
 	Vector<Ref<IKBoneSegment3D>> segmented_skeletons;
 	int32_t constraint_count = 0, pin_count = 0, bone_count = 0;
@@ -55,21 +78,91 @@ class ManyBoneIK3D : public SkeletonModifier3D {
 	Vector<Ref<IKBone3D>> bone_list;
 	Vector<Vector2> joint_twist;
 	Vector<float> bone_damp;
+	// cos(damp / 2) per bone id and for the default damp, rebuilt with the rig so the solver never calls cos.
+	Vector<ik_real_t> bone_cos_half_damp;
+	ik_real_t default_cos_half_damp = 1.0;
 	Vector<Vector<Vector4>> kusudama_open_cones;
 	Vector<int> kusudama_open_cone_count;
-	float MAX_KUSUDAMA_OPEN_CONES = 10;
 	int32_t iterations_per_frame = 15;
+	int32_t coarse_iterations = 0;
 	float default_damp = Math::deg_to_rad(5.0f);
 	Ref<IKNode3D> godot_skeleton_transform;
 	Transform3D godot_skeleton_transform_inverse;
 	Ref<IKNode3D> ik_origin;
+	// Every solver transform of the live rig and the query rigs comes from here, and is reused after a rebuild.
+	IKNode3DPool node_pool;
 	bool is_dirty = true;
 	NodePath skeleton_node_path = NodePath("..");
 	int32_t ui_selected_bone = -1, stabilize_passes = 0;
+	bool editor_background_solve = true;
+	bool deterministic = false;
+	mutable WorkerThreadPool::TaskID background_solve_task = WorkerThreadPool::INVALID_TASK_ID;
+	mutable bool background_solve_publish = false;
+	// Set by set_state until the next solve, so the restored pin targets are not replaced by the target nodes.
+	bool keep_restored_targets = false;
+	LocalVector<BoneId> published_bone_ids;
+	LocalVector<Transform3D> published_bone_poses;
+	LocalVector<PublishedConstraint> published_constraints;
+
+	// What a solve reads from this node, copied when a background solve launches so setters never race the worker.
+	struct SolveSettings {
+		int32_t iterations = 0;
+		int32_t coarse_iterations = 0;
+		bool constraint_mode = false;
+		Vector<ik_real_t> bone_cos_half_damp;
+		ik_real_t default_cos_half_damp = 1.0;
+	};
+	SolveSettings background_solve_settings;
+
+	// A private copy of the rig with its own bones, segments and origin node, so queries never write the live transforms.
+	struct QueryRig {
+		Vector<Ref<IKBoneSegment3D>> segments;
+		Vector<Ref<IKBone3D>> bones;
+		Ref<IKNode3D> origin;
+	};
+	struct ReachabilityQuery {
+		int32_t pinned_bone = -1;
+		SolveSettings settings;
+		uint32_t rig_count = 0;
+		LocalVector<Transform3D> bone_poses;
+		LocalVector<Transform3D> effector_targets;
+		LocalVector<Vector3> targets;
+		Vector2 *results = nullptr;
+	};
+	struct BakeQuery {
+		SolveSettings settings;
+		uint32_t bone_count = 0;
+		uint32_t frame_count = 0;
+		uint32_t rig_count = 0;
+		// Frame major: frame_i * bone_count + bone_i.
+		LocalVector<Transform3D> input_poses;
+		LocalVector<Transform3D> effector_targets;
+		LocalVector<Transform3D> solved_poses;
+	};
+	LocalVector<QueryRig> query_rigs;
+	// Bones whose skeleton pose, or an ancestor's, differed from the solver's copy on the last read, indexed by bone id.
+	LocalVector<uint8_t> pose_changed_mask;
 
 	void _on_timer_timeout();
 	void _update_ik_bones_transform();
+	void _read_rig_pose(const Vector<Ref<IKBone3D>> &p_bones);
+	void _build_rig(Vector<Ref<IKBoneSegment3D>> &r_segments, Vector<Ref<IKBone3D>> &r_bones, Ref<IKNode3D> &r_origin);
+	static void _release_rig(Vector<Ref<IKBoneSegment3D>> &r_segments, Vector<Ref<IKBone3D>> &r_bones, Ref<IKNode3D> &r_origin);
+	void _release_rigs();
+	void _query_reachability_chunk(uint32_t p_rig_index, ReachabilityQuery *p_query);
+	void _bake_animation_chunk(uint32_t p_rig_index, BakeQuery *p_query);
+	static real_t _get_limit_saturation(const Ref<IKBone3D> &p_tip);
+	Dictionary _set_constraint_cones(int32_t p_constraint_index, const Vector<Vector4> &p_cones);
 	void _update_skeleton_bones_transform();
+	void _update_effector_targets();
+	SolveSettings _get_solve_settings() const;
+	void _solve_iterations(const Vector<Ref<IKBoneSegment3D>> &p_segments, const SolveSettings &p_settings);
+	bool _is_background_solve_active() const;
+	void _background_solve_task(void *p_userdata);
+	void _wait_for_background_solve() const;
+	void _store_published_bone_poses();
+	void _store_published_constraints();
+	void _apply_published_bone_poses();
 	Vector<Ref<IKEffectorTemplate3D>> _get_bone_effectors() const;
 	void set_constraint_name_at_index(int32_t p_index, String p_name);
 	void set_total_effector_count(int32_t p_value);
@@ -79,6 +172,7 @@ class ManyBoneIK3D : public SkeletonModifier3D {
 	void _set_pin_root_bone(int32_t p_pin_index, const String &p_root_bone);
 	String _get_pin_root_bone(int32_t p_pin_index) const;
 	void _bone_list_changed();
+	void _update_damp_schedule();
 	void _pose_updated();
 	void _update_ik_bone_pose(int32_t p_bone_idx);
 
@@ -95,11 +189,32 @@ public:
 	bool get_effector_target_fixed(int32_t p_effector_index);
 	void set_state(Ref<ManyBoneIK3DState> p_state);
 	Ref<ManyBoneIK3DState> get_state() const;
+	void capture_state(Ref<ManyBoneIK3DState> r_state) const;
+	void set_state_data(const ManyBoneIK3DStateData &p_state);
+	void capture_state_data(ManyBoneIK3DStateData &r_state) const;
 	void add_constraint();
 	void set_stabilization_passes(int32_t p_passes);
 	int32_t get_stabilization_passes();
+	PackedVector3Array sample_constraint_directions(int32_t p_constraint_index, AnimationPlayer *p_player, const StringName &p_animation, float p_fps = 30.0f);
+	Dictionary fit_constraint_cones(int32_t p_constraint_index, const PackedVector3Array &p_directions, float p_max_radius);
+	Dictionary simplify_constraint_cones(int32_t p_constraint_index, float p_tolerance);
+	PackedVector2Array query_reachability(int32_t p_pin_index, const PackedVector3Array &p_targets, int32_t p_iterations = 10);
+	Ref<Animation> bake_animation(AnimationPlayer *p_player, const StringName &p_animation, float p_fps = 30.0f, float p_tolerance = 0.0f);
+	void set_deterministic(bool p_enabled);
+	bool get_deterministic() const;
+	void set_editor_background_solve(bool p_enabled);
+	bool get_editor_background_solve() const;
+	void set_analytic_short_chains(bool p_enabled);
+	bool get_analytic_short_chains() const;
+	void set_fabrik_unconstrained_chains(bool p_enabled);
+	bool get_fabrik_unconstrained_chains() const;
+	void set_iteration_scheme(IterationScheme p_scheme);
+	IterationScheme get_iteration_scheme() const;
+	void set_jacobi_relaxation(float p_relaxation);
+	float get_jacobi_relaxation() const;
 	Transform3D get_godot_skeleton_transform_inverse();
 	Ref<IKNode3D> get_godot_skeleton_transform();
+	IKNode3DPool *get_node_pool();
 	void set_ui_selected_bone(int32_t p_ui_selected_bone);
 	int32_t get_ui_selected_bone() const;
 	void set_constraint_mode(bool p_enabled);
@@ -108,9 +223,12 @@ public:
 	void register_skeleton();
 	void reset_constraints();
 	Vector<Ref<IKBone3D>> get_bone_list() const;
+	const LocalVector<PublishedConstraint> &get_published_constraints() const;
 	Vector<Ref<IKBoneSegment3D>> get_segmented_skeletons();
 	float get_iterations_per_frame() const;
 	void set_iterations_per_frame(const float &p_iterations_per_frame);
+	int32_t get_coarse_iterations() const;
+	void set_coarse_iterations(int32_t p_coarse_iterations);
 	void queue_print_skeleton();
 	int32_t get_effector_count() const;
 	void set_effector_count(int32_t p_pin_count);
@@ -126,6 +244,8 @@ public:
 	void set_pin_direction_priorities(int32_t p_pin_index, const Vector3 &p_priority_direction);
 	Vector3 get_pin_direction_priorities(int32_t p_pin_index) const;
 	NodePath get_effector_target_node_path(int32_t p_pin_index);
+	void set_pin_pole_node_path(int32_t p_pin_index, const NodePath &p_pole_node);
+	NodePath get_pin_pole_node_path(int32_t p_pin_index) const;
 	void set_pin_motion_propagation_factor(int32_t p_effector_index, const float p_motion_propagation_factor);
 	float get_pin_motion_propagation_factor(int32_t p_effector_index) const;
 	real_t get_default_damp() const;
@@ -157,4 +277,6 @@ public:
 	void set_dirty();
 };
 
+VARIANT_ENUM_CAST(ManyBoneIK3D::IterationScheme);
+
 #endif // MANY_BONE_IK_3D_H
@@ -0,0 +1,198 @@
+/**************************************************************************/
+/*  many_bone_ik_3d_regression_runner.cpp                                 */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#include "many_bone_ik_3d_regression_runner.h"
+
+#include "core/io/dir_access.h"
+#include "core/io/file_access.h"
+#include "core/io/resource_loader.h"
+#include "core/os/os.h"
+#include "core/templates/local_vector.h"
+#include "ik_bone_3d.h"
+#include "many_bone_ik_3d.h"
+#include "scene/3d/skeleton_3d.h"
+#include "scene/animation/animation_player.h"
+#include "scene/main/scene_tree.h"
+#include "scene/main/window.h"
+#include "scene/resources/packed_scene.h"
+
+void ManyBoneIK3DRegressionRunner::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("run_scene", "scene_path", "output_path", "frames", "fps"), &ManyBoneIK3DRegressionRunner::run_scene, DEFVAL(120), DEFVAL(60.0));
+	ClassDB::bind_method(D_METHOD("run_directory", "scene_directory", "output_directory", "frames", "fps"), &ManyBoneIK3DRegressionRunner::run_directory, DEFVAL(120), DEFVAL(60.0));
+}
+
+void ManyBoneIK3DRegressionRunner::_start_animations(Node *p_scene) {
+	TypedArray<Node> players = p_scene->find_children("*", "AnimationPlayer", true, false);
+	for (int32_t player_i = 0; player_i < players.size(); player_i++) {
+		AnimationPlayer *player = Object::cast_to<AnimationPlayer>(players[player_i]);
+		if (!player) {
+			continue;
+		}
+		player->set_callback_mode_process(AnimationMixer::ANIMATION_CALLBACK_MODE_PROCESS_MANUAL);
+		String autoplay = player->get_autoplay();
+		if (!autoplay.is_empty() && player->has_animation(autoplay)) {
+			player->play(autoplay);
+			player->seek(0.0, true);
+		}
+	}
+}
+
+void ManyBoneIK3DRegressionRunner::_advance_animations(Node *p_scene, double p_delta) {
+	TypedArray<Node> players = p_scene->find_children("*", "AnimationPlayer", true, false);
+	for (int32_t player_i = 0; player_i < players.size(); player_i++) {
+		AnimationPlayer *player = Object::cast_to<AnimationPlayer>(players[player_i]);
+		if (player && player->is_playing()) {
+			player->advance(p_delta);
+		}
+	}
+}
+
+Error ManyBoneIK3DRegressionRunner::run_scene(const String &p_scene_path, const String &p_output_path, int32_t p_frames, float p_fps) {
+	ERR_FAIL_COND_V_MSG(p_frames <= 0, ERR_INVALID_PARAMETER, "The frame count must be greater than zero.");
+	ERR_FAIL_COND_V_MSG(p_fps <= 0.0f, ERR_INVALID_PARAMETER, "The frame rate must be greater than zero.");
+	Ref<PackedScene> packed_scene = ResourceLoader::load(p_scene_path, "PackedScene");
+	ERR_FAIL_COND_V_MSG(packed_scene.is_null(), ERR_CANT_OPEN, vformat("Could not load the scene \"%s\".", p_scene_path));
+	SceneTree *tree = Object::cast_to<SceneTree>(OS::get_singleton()->get_main_loop());
+	ERR_FAIL_NULL_V_MSG(tree, ERR_UNCONFIGURED, "The regression runner needs a SceneTree main loop.");
+	Error err = OK;
+	Ref<FileAccess> file = FileAccess::open(p_output_path, FileAccess::WRITE, &err);
+	ERR_FAIL_COND_V_MSG(file.is_null(), err, vformat("Could not open \"%s\" for writing.", p_output_path));
+
+	Node *scene = packed_scene->instantiate();
+	ERR_FAIL_NULL_V(scene, ERR_CANT_CREATE);
+	// Global transforms are only valid inside the tree. Nothing is processed by the tree itself, every solve below is driven explicitly.
+	tree->get_root()->add_child(scene);
+	_start_animations(scene);
+	// Group the nodes by skeleton, in tree order, which is the order the skeleton runs its modifiers in.
+	TypedArray<Node> iks = scene->find_children("*", "ManyBoneIK3D", true, false);
+	LocalVector<Skeleton3D *> skeletons;
+	LocalVector<LocalVector<ManyBoneIK3D *>> skeleton_iks;
+	for (int32_t ik_i = 0; ik_i < iks.size(); ik_i++) {
+		ManyBoneIK3D *ik = Object::cast_to<ManyBoneIK3D>(iks[ik_i]);
+		if (!ik || !ik->get_skeleton()) {
+			continue;
+		}
+		int64_t skeleton_i = skeletons.find(ik->get_skeleton());
+		if (skeleton_i == -1) {
+			skeleton_i = skeletons.size();
+			skeletons.push_back(ik->get_skeleton());
+			skeleton_iks.resize(skeletons.size());
+		}
+		skeleton_iks[skeleton_i].push_back(ik);
+	}
+
+	// usec is the time spent in _process_modification alone; reading the result back and blending it are not counted.
+	file->store_line("frame,usec,node,bone,px,py,pz,qx,qy,qz,qw");
+	double delta = 1.0 / p_fps;
+	LocalVector<Transform3D> frame_poses;
+	LocalVector<Transform3D> pre_modifier_poses;
+	for (int32_t frame_i = 0; frame_i < p_frames; frame_i++) {
+		if (frame_i > 0) {
+			_advance_animations(scene, delta);
+		}
+		for (uint32_t skeleton_i = 0; skeleton_i < skeletons.size(); skeleton_i++) {
+			// Same steps as the skeleton update: snapshot the animated poses, run every modifier on top of the previous one, and restore the snapshot after the last.
+			Skeleton3D *skeleton = skeletons[skeleton_i];
+			const int32_t bone_count = skeleton->get_bone_count();
+			frame_poses.resize(bone_count);
+			for (int32_t bone_i = 0; bone_i < bone_count; bone_i++) {
+				frame_poses[bone_i] = skeleton->get_bone_pose(bone_i);
+			}
+			for (ManyBoneIK3D *ik : skeleton_iks[skeleton_i]) {
+				if (!ik->is_active()) {
+					continue;
+				}
+				// Skeleton3D::_process_modifiers() blends each modifier by influence against the poses it started from.
+				const real_t influence = ik->get_influence();
+				if (influence < 1.0) {
+					pre_modifier_poses.resize(bone_count);
+					for (int32_t bone_i = 0; bone_i < bone_count; bone_i++) {
+						pre_modifier_poses[bone_i] = skeleton->get_bone_pose(bone_i);
+					}
+				}
+				uint64_t start = OS::get_singleton()->get_ticks_usec();
+				ik->_process_modification();
+				uint64_t usec = OS::get_singleton()->get_ticks_usec() - start;
+				// modification_processed reads the result back as the next warm start.
+				ik->_update_ik_bones_transform();
+				if (influence < 1.0) {
+					for (int32_t bone_i = 0; bone_i < bone_count; bone_i++) {
+						Transform3D solved_pose = skeleton->get_bone_pose(bone_i);
+						if (solved_pose == pre_modifier_poses[bone_i]) {
+							continue;
+						}
+						skeleton->set_bone_pose(bone_i, pre_modifier_poses[bone_i].interpolate_with(solved_pose, influence));
+					}
+				}
+
+				String node_path = scene->get_path_to(ik);
+				for (const Ref<IKBone3D> &bone : ik->get_bone_list()) {
+					if (bone.is_null() || bone->get_bone_id() == -1) {
+						continue;
+					}
+					Transform3D pose = skeleton->get_bone_pose(bone->get_bone_id());
+					Quaternion rotation = pose.basis.get_rotation_quaternion();
+					file->store_line(vformat("%d,%d,%s,%s,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f", frame_i, int64_t(usec), node_path, skeleton->get_bone_name(bone->get_bone_id()),
+							pose.origin.x, pose.origin.y, pose.origin.z, rotation.x, rotation.y, rotation.z, rotation.w));
+				}
+			}
+			for (int32_t bone_i = 0; bone_i < bone_count; bone_i++) {
+				skeleton->set_bone_pose(bone_i, frame_poses[bone_i]);
+			}
+		}
+	}
+
+	tree->get_root()->remove_child(scene);
+	memdelete(scene);
+	return OK;
+}
+
+Error ManyBoneIK3DRegressionRunner::run_directory(const String &p_scene_directory, const String &p_output_directory, int32_t p_frames, float p_fps) {
+	Ref<DirAccess> dir = DirAccess::open(p_scene_directory);
+	ERR_FAIL_COND_V_MSG(dir.is_null(), ERR_CANT_OPEN, vformat("Could not open the directory \"%s\".", p_scene_directory));
+	Error err = DirAccess::make_dir_recursive_absolute(p_output_directory);
+	ERR_FAIL_COND_V_MSG(err != OK, err, vformat("Could not create the directory \"%s\".", p_output_directory));
+
+	PackedStringArray files = dir->get_files();
+	files.sort();
+	Error result = OK;
+	for (const String &file : files) {
+		String extension = file.get_extension().to_lower();
+		if (extension != "tscn" && extension != "scn") {
+			continue;
+		}
+		String output_path = p_output_directory.path_join(file.get_basename() + ".csv");
+		err = run_scene(p_scene_directory.path_join(file), output_path, p_frames, p_fps);
+		if (err != OK) {
+			result = err;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,54 @@
+/**************************************************************************/
+/*  many_bone_ik_3d_regression_runner.h                                   */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef MANY_BONE_IK_3D_REGRESSION_RUNNER_H
+#define MANY_BONE_IK_3D_REGRESSION_RUNNER_H
+
+#include "core/object/ref_counted.h"
+
+class Node;
+
+// Solves the ManyBoneIK3D nodes of a scene frame by frame, driven by the scene's autoplay animations, and writes the poses and timings to CSV.
+// Meant for `--headless --script` runs in CI, where the output is diffed against a stored baseline.
+class ManyBoneIK3DRegressionRunner : public RefCounted {
+	GDCLASS(ManyBoneIK3DRegressionRunner, RefCounted);
+
+	void _start_animations(Node *p_scene);
+	void _advance_animations(Node *p_scene, double p_delta);
+
+protected:
+	static void _bind_methods();
+
+public:
+	Error run_scene(const String &p_scene_path, const String &p_output_path, int32_t p_frames = 120, float p_fps = 60.0f);
+	Error run_directory(const String &p_scene_directory, const String &p_output_directory, int32_t p_frames = 120, float p_fps = 60.0f);
+};
+
+#endif // MANY_BONE_IK_3D_REGRESSION_RUNNER_H
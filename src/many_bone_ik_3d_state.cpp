@@ -0,0 +1,94 @@
+/**************************************************************************/
+/*  many_bone_ik_3d_state.cpp                                             */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#include "many_bone_ik_3d_state.h"
+
+void ManyBoneIK3DState::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_bone_count"), &ManyBoneIK3DState::get_bone_count);
+	ClassDB::bind_method(D_METHOD("get_bone_id", "index"), &ManyBoneIK3DState::get_bone_id);
+	ClassDB::bind_method(D_METHOD("get_bone_pose", "index"), &ManyBoneIK3DState::get_bone_pose);
+	ClassDB::bind_method(D_METHOD("set_bone_pose", "index", "pose"), &ManyBoneIK3DState::set_bone_pose);
+	ClassDB::bind_method(D_METHOD("get_effector_count"), &ManyBoneIK3DState::get_effector_count);
+	ClassDB::bind_method(D_METHOD("get_effector_target", "index"), &ManyBoneIK3DState::get_effector_target);
+	ClassDB::bind_method(D_METHOD("set_effector_target", "index", "target"), &ManyBoneIK3DState::set_effector_target);
+	ClassDB::bind_method(D_METHOD("copy_from", "state"), &ManyBoneIK3DState::copy_from);
+	ClassDB::bind_method(D_METHOD("clear"), &ManyBoneIK3DState::clear);
+}
+
+ManyBoneIK3DStateData &ManyBoneIK3DState::get_data() {
+	return data;
+}
+
+const ManyBoneIK3DStateData &ManyBoneIK3DState::get_data() const {
+	return data;
+}
+
+int32_t ManyBoneIK3DState::get_bone_count() const {
+	return data.bone_poses.size();
+}
+
+BoneId ManyBoneIK3DState::get_bone_id(int32_t p_index) const {
+	ERR_FAIL_INDEX_V(p_index, (int32_t)data.bone_ids.size(), -1);
+	return data.bone_ids[p_index];
+}
+
+Transform3D ManyBoneIK3DState::get_bone_pose(int32_t p_index) const {
+	ERR_FAIL_INDEX_V(p_index, (int32_t)data.bone_poses.size(), Transform3D());
+	return data.bone_poses[p_index];
+}
+
+void ManyBoneIK3DState::set_bone_pose(int32_t p_index, const Transform3D &p_pose) {
+	ERR_FAIL_INDEX(p_index, (int32_t)data.bone_poses.size());
+	data.bone_poses[p_index] = p_pose;
+}
+
+int32_t ManyBoneIK3DState::get_effector_count() const {
+	return data.effector_targets.size();
+}
+
+Transform3D ManyBoneIK3DState::get_effector_target(int32_t p_index) const {
+	ERR_FAIL_INDEX_V(p_index, (int32_t)data.effector_targets.size(), Transform3D());
+	return data.effector_targets[p_index];
+}
+
+void ManyBoneIK3DState::set_effector_target(int32_t p_index, const Transform3D &p_target) {
+	ERR_FAIL_INDEX(p_index, (int32_t)data.effector_targets.size());
+	data.effector_targets[p_index] = p_target;
+}
+
+void ManyBoneIK3DState::copy_from(const Ref<ManyBoneIK3DState> &p_state) {
+	ERR_FAIL_COND(p_state.is_null());
+	// LocalVector keeps its capacity, so a pooled state stops allocating once it has seen the rig.
+	data = p_state->data;
+}
+
+void ManyBoneIK3DState::clear() {
+	data.clear();
+}
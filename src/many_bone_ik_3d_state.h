@@ -0,0 +1,80 @@
+/**************************************************************************/
+/*  many_bone_ik_3d_state.h                                               */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef MANY_BONE_IK_3D_STATE_H
+#define MANY_BONE_IK_3D_STATE_H
+
+#include "core/math/transform_3d.h"
+#include "core/object/ref_counted.h"
+#include "core/templates/local_vector.h"
+#include "math/ik_precision.h"
+#include "scene/3d/skeleton_3d.h"
+
+// Flat snapshot of a ManyBoneIK3D solve: the local pose of every IK bone in bone list order,
+// the stabilization deviation of every segment in depth-first order and the target of every pinned bone.
+// A plain struct, so C++ callers can keep snapshots by value without a reference counted object per frame.
+struct ManyBoneIK3DStateData {
+	LocalVector<BoneId> bone_ids;
+	LocalVector<Transform3D> bone_poses;
+	LocalVector<ik_real_t> previous_deviations;
+	LocalVector<Transform3D> effector_targets;
+
+	void clear() {
+		bone_ids.clear();
+		bone_poses.clear();
+		previous_deviations.clear();
+		effector_targets.clear();
+	}
+};
+
+// Exposes a ManyBoneIK3DStateData to scripts.
+class ManyBoneIK3DState : public RefCounted {
+	GDCLASS(ManyBoneIK3DState, RefCounted);
+
+	ManyBoneIK3DStateData data;
+
+protected:
+	static void _bind_methods();
+
+public:
+	ManyBoneIK3DStateData &get_data();
+	const ManyBoneIK3DStateData &get_data() const;
+	int32_t get_bone_count() const;
+	BoneId get_bone_id(int32_t p_index) const;
+	Transform3D get_bone_pose(int32_t p_index) const;
+	void set_bone_pose(int32_t p_index, const Transform3D &p_pose);
+	int32_t get_effector_count() const;
+	Transform3D get_effector_target(int32_t p_index) const;
+	void set_effector_target(int32_t p_index, const Transform3D &p_target);
+	void copy_from(const Ref<ManyBoneIK3DState> &p_state);
+	void clear();
+};
+
+#endif // MANY_BONE_IK_3D_STATE_H
@@ -33,7 +33,7 @@
 void IKNode3D::_propagate_transform_changed() {
 	Vector<Ref<IKNode3D>> to_remove;
 
-	for (Ref<IKNode3D> transform : children) {
+	for (const Ref<IKNode3D> &transform : children) {
 		if (transform.is_null()) {
 			to_remove.push_back(transform);
 		} else {
@@ -41,7 +41,7 @@ void IKNode3D::_propagate_transform_changed() {
 		}
 	}
 
-	for (Ref<IKNode3D> transform : to_remove) {
+	for (const Ref<IKNode3D> &transform : to_remove) {
 		children.erase(transform);
 	}
 
@@ -54,11 +54,10 @@ void IKNode3D::_update_local_transform() const {
 }
 
 void IKNode3D::rotate_local_with_global(const Basis &p_basis, bool p_propagate) {
-	if (parent.get_ref().is_null()) {
+	if (!parent) {
 		return;
 	}
-	Ref<IKNode3D> parent_ik_node = parent.get_ref();
-	const Basis &new_rot = parent_ik_node->get_global_transform().basis;
+	const Basis new_rot = parent->get_global_transform().basis;
 	local_transform.basis = new_rot.inverse() * p_basis * new_rot * local_transform.basis;
 	dirty |= DIRTY_GLOBAL;
 	if (p_propagate) {
@@ -74,9 +73,17 @@ void IKNode3D::set_transform(const Transform3D &p_transform) {
 	}
 }
 
+bool IKNode3D::set_transform_deferred(const Transform3D &p_transform) {
+	if (local_transform == p_transform) {
+		return false;
+	}
+	local_transform = p_transform;
+	dirty |= DIRTY_VECTORS | DIRTY_GLOBAL;
+	return true;
+}
+
 void IKNode3D::set_global_transform(const Transform3D &p_transform) {
-	Ref<IKNode3D> ik_node = parent.get_ref();
-	Transform3D xform = ik_node.is_valid() ? ik_node->get_global_transform().affine_inverse() * p_transform : p_transform;
+	Transform3D xform = parent ? parent->get_global_transform().affine_inverse() * p_transform : p_transform;
 	local_transform = xform;
 	dirty |= DIRTY_VECTORS;
 	_propagate_transform_changed();
@@ -95,9 +102,8 @@ Transform3D IKNode3D::get_global_transform() const {
 		if (dirty & DIRTY_LOCAL) {
 			_update_local_transform();
 		}
-		Ref<IKNode3D> ik_node = parent.get_ref();
-		if (ik_node.is_valid()) {
-			global_transform = ik_node->get_global_transform() * local_transform;
+		if (parent) {
+			global_transform = parent->get_global_transform() * local_transform;
 		} else {
 			global_transform = local_transform;
 		}
@@ -124,7 +130,7 @@ void IKNode3D::set_parent(Ref<IKNode3D> p_parent) {
 	if (p_parent.is_valid()) {
 		p_parent->children.erase(this);
 	}
-	parent.set_ref(p_parent);
+	parent = p_parent.ptr();
 	if (p_parent.is_valid()) {
 		p_parent->children.push_back(this);
 	}
@@ -132,7 +138,7 @@ void IKNode3D::set_parent(Ref<IKNode3D> p_parent) {
 }
 
 Ref<IKNode3D> IKNode3D::get_parent() const {
-	return parent.get_ref();
+	return Ref<IKNode3D>(parent);
 }
 
 Vector3 IKNode3D::to_local(const Vector3 &p_global) const {
@@ -157,3 +163,61 @@ void IKNode3D::cleanup() {
 		child->set_parent(Ref<IKNode3D>());
 	}
 }
+
+void IKNode3D::reset() {
+	// Unlike cleanup(), nothing is propagated: the children are being discarded or reset as well.
+	for (Ref<IKNode3D> &child : children) {
+		child->parent = nullptr;
+	}
+	children.clear();
+	parent = nullptr;
+	global_transform = Transform3D();
+	local_transform = Transform3D();
+	rotation = Basis();
+	scale = Vector3(1, 1, 1);
+	dirty = DIRTY_NONE;
+	disable_scale = false;
+}
+
+Ref<IKNode3D> IKNode3DPool::acquire() {
+	while (next_node < nodes.size()) {
+		Ref<IKNode3D> &node = nodes[next_node++];
+		if (node->get_reference_count() == 1) {
+			node->reset();
+			return node;
+		}
+	}
+	Ref<IKNode3D> node;
+	node.instantiate();
+	nodes.push_back(node);
+	next_node = nodes.size();
+	return node;
+}
+
+void IKNode3DPool::reclaim() {
+	// Parents reference their children, so a node only the pool holds releases its whole subtree.
+	LocalVector<Ref<IKNode3D>> released;
+	for (Ref<IKNode3D> &node : nodes) {
+		if (node->get_reference_count() != 1 || node->children.is_empty()) {
+			continue;
+		}
+		released.push_back(node);
+		while (!released.is_empty()) {
+			Ref<IKNode3D> current = released[released.size() - 1];
+			released.remove_at(released.size() - 1);
+			for (Ref<IKNode3D> &child : current->children) {
+				child->parent = nullptr;
+				// Held by the pool and its parent only.
+				if (child->get_reference_count() == 2) {
+					released.push_back(child);
+				}
+			}
+			current->children.clear();
+		}
+	}
+	next_node = 0;
+}
+
+uint32_t IKNode3DPool::size() const {
+	return nodes.size();
+}
@@ -33,12 +33,14 @@
 
 #include "core/object/ref_counted.h"
 #include "core/templates/list.h"
+#include "core/templates/local_vector.h"
 
 #include "core/io/resource.h"
 #include "core/math/transform_3d.h"
 
 class IKNode3D : public RefCounted {
 	GDCLASS(IKNode3D, RefCounted);
+	friend class IKNode3DPool;
 
 	enum TransformDirty {
 		DIRTY_NONE = 0,
@@ -54,7 +56,8 @@ class IKNode3D : public RefCounted {
 
 	mutable int dirty = DIRTY_NONE;
 
-	WeakRef parent;
+	// Borrowed: a node clears its children's parent when it is freed, see cleanup().
+	IKNode3D *parent = nullptr;
 	List<Ref<IKNode3D>> children;
 
 	bool disable_scale = false;
@@ -82,6 +85,9 @@ protected:
 public:
 	void _propagate_transform_changed();
 	void set_transform(const Transform3D &p_transform);
+	// Writes the local transform without invalidating descendants. Returns true if it changed.
+	// The caller is responsible for calling _propagate_transform_changed() on an ancestor afterwards.
+	bool set_transform_deferred(const Transform3D &p_transform);
 	void set_global_transform(const Transform3D &p_transform);
 	Transform3D get_transform() const;
 	Transform3D get_global_transform() const;
@@ -96,7 +102,22 @@ public:
 	Vector3 to_global(const Vector3 &p_local) const;
 	void rotate_local_with_global(const Basis &p_basis, bool p_propagate = false);
 	void cleanup();
+	// Drops the links to the parent and children and returns to the identity transform. Only for nodes no parent lists any more.
+	void reset();
 	~IKNode3D();
 };
 
+// Hands out IKNode3D objects and takes them back on rig rebuilds, so a rebuild does not create and free four Objects per bone.
+// A node is only handed out again once nothing outside the pool references it.
+class IKNode3DPool {
+	LocalVector<Ref<IKNode3D>> nodes;
+	uint32_t next_node = 0;
+
+public:
+	Ref<IKNode3D> acquire();
+	// Call after releasing a rig. Starts handing out the nodes nothing references any more.
+	void reclaim();
+	uint32_t size() const;
+};
+
 #endif // IK_NODE_3D_H
@@ -30,7 +30,7 @@
 
 #include "qcp.h"
 
-QCP::QCP(double p_evec_prec) {
+QCP::QCP(ik_real_t p_evec_prec) {
 	eigenvector_precision = p_evec_prec;
 }
 
@@ -57,53 +57,35 @@ Quaternion QCP::calculate_rotation() {
 	Quaternion result;
 
 	if (moved.size() == 1) {
-		Vector3 u = moved[0];
-		Vector3 v = target[0];
-		double norm_product = u.length() * v.length();
-
-		if (norm_product == 0.0) {
-			return Quaternion();
-		}
-
-		double dot = u.dot(v);
-
-		if (dot < ((2.0e-15 - 1.0) * norm_product)) {
-			Vector3 w = u.normalized();
-			result = Quaternion(w.x, w.y, w.z, 0.0f).normalized();
-		} else {
-			double q0 = Math::sqrt(0.5 * (1.0 + dot / norm_product));
-			double coeff = 1.0 / (2.0 * q0 * norm_product);
-			Vector3 q = v.cross(u).normalized();
-			result = Quaternion(coeff * q.x, coeff * q.y, coeff * q.z, q0).normalized();
-		}
+		result = get_shortest_arc(moved[0], target[0]);
 	} else {
-		double a13 = -sum_xz_minus_zx;
-		double a14 = sum_xy_minus_yx;
-		double a21 = sum_yz_minus_zy;
-		double a22 = sum_xx_minus_yy - sum_zz - max_eigenvalue;
-		double a23 = sum_xy_plus_yx;
-		double a24 = sum_xz_plus_zx;
-		double a31 = a13;
-		double a32 = a23;
-		double a33 = sum_yy - sum_xx - sum_zz - max_eigenvalue;
-		double a34 = sum_yz_plus_zy;
-		double a41 = a14;
-		double a42 = a24;
-		double a43 = a34;
-		double a44 = sum_zz - sum_xx_plus_yy - max_eigenvalue;
-
-		double a3344_4334 = a33 * a44 - a43 * a34;
-		double a3244_4234 = a32 * a44 - a42 * a34;
-		double a3243_4233 = a32 * a43 - a42 * a33;
-		double a3143_4133 = a31 * a43 - a41 * a33;
-		double a3144_4134 = a31 * a44 - a41 * a34;
-		double a3142_4132 = a31 * a42 - a41 * a32;
-
-		double quaternion_w = a22 * a3344_4334 - a23 * a3244_4234 + a24 * a3243_4233;
-		double quaternion_x = -a21 * a3344_4334 + a23 * a3144_4134 - a24 * a3143_4133;
-		double quaternion_y = a21 * a3244_4234 - a22 * a3144_4134 + a24 * a3142_4132;
-		double quaternion_z = -a21 * a3243_4233 + a22 * a3143_4133 - a23 * a3142_4132;
-		double qsqr = quaternion_w * quaternion_w + quaternion_x * quaternion_x + quaternion_y * quaternion_y + quaternion_z * quaternion_z;
+		ik_real_t a13 = -sum_xz_minus_zx;
+		ik_real_t a14 = sum_xy_minus_yx;
+		ik_real_t a21 = sum_yz_minus_zy;
+		ik_real_t a22 = sum_xx_minus_yy - sum_zz - max_eigenvalue;
+		ik_real_t a23 = sum_xy_plus_yx;
+		ik_real_t a24 = sum_xz_plus_zx;
+		ik_real_t a31 = a13;
+		ik_real_t a32 = a23;
+		ik_real_t a33 = sum_yy - sum_xx - sum_zz - max_eigenvalue;
+		ik_real_t a34 = sum_yz_plus_zy;
+		ik_real_t a41 = a14;
+		ik_real_t a42 = a24;
+		ik_real_t a43 = a34;
+		ik_real_t a44 = sum_zz - sum_xx_plus_yy - max_eigenvalue;
+
+		ik_real_t a3344_4334 = a33 * a44 - a43 * a34;
+		ik_real_t a3244_4234 = a32 * a44 - a42 * a34;
+		ik_real_t a3243_4233 = a32 * a43 - a42 * a33;
+		ik_real_t a3143_4133 = a31 * a43 - a41 * a33;
+		ik_real_t a3144_4134 = a31 * a44 - a41 * a34;
+		ik_real_t a3142_4132 = a31 * a42 - a41 * a32;
+
+		ik_real_t quaternion_w = a22 * a3344_4334 - a23 * a3244_4234 + a24 * a3243_4233;
+		ik_real_t quaternion_x = -a21 * a3344_4334 + a23 * a3144_4134 - a24 * a3143_4133;
+		ik_real_t quaternion_y = a21 * a3244_4234 - a22 * a3144_4134 + a24 * a3142_4132;
+		ik_real_t quaternion_z = -a21 * a3243_4233 + a22 * a3143_4133 - a23 * a3142_4132;
+		ik_real_t qsqr = quaternion_w * quaternion_w + quaternion_x * quaternion_x + quaternion_y * quaternion_y + quaternion_z * quaternion_z;
 
 		if (qsqr < eigenvector_precision) {
 			result = Quaternion();
@@ -111,7 +93,7 @@ Quaternion QCP::calculate_rotation() {
 			quaternion_x *= -1;
 			quaternion_y *= -1;
 			quaternion_z *= -1;
-			double min = quaternion_w;
+			ik_real_t min = quaternion_w;
 			min = quaternion_x < min ? quaternion_x : min;
 			min = quaternion_y < min ? quaternion_y : min;
 			min = quaternion_z < min ? quaternion_z : min;
@@ -126,6 +108,28 @@ Quaternion QCP::calculate_rotation() {
 	return result;
 }
 
+Quaternion QCP::get_shortest_arc(const Vector3 &p_moved, const Vector3 &p_target) {
+	ik_real_t norm_product = p_moved.length() * p_target.length();
+
+	if (norm_product == 0.0) {
+		return Quaternion();
+	}
+
+	ik_real_t dot = p_moved.dot(p_target);
+	Vector3 q = p_moved.cross(p_target);
+	ik_real_t w = norm_product + dot;
+
+	// The headings are only as exact as real_t, so anything within its epsilon of opposite takes the half turn.
+	if (w <= CMP_EPSILON * norm_product) {
+		// Opposite headings: half a turn around any axis perpendicular to them.
+		Vector3 reference = Math::abs(p_moved.x) < Math::abs(p_moved.y) ? Vector3(1, 0, 0) : Vector3(0, 1, 0);
+		Vector3 axis = p_moved.cross(reference).normalized();
+		return Quaternion(axis.x, axis.y, axis.z, 0.0f);
+	}
+
+	return Quaternion(q.x, q.y, q.z, w).normalized();
+}
+
 void QCP::translate(Vector3 r_translate, PackedVector3Array &r_x) {
 	for (Vector3 &p : r_x) {
 		p += r_translate;
@@ -136,9 +140,9 @@ Vector3 QCP::get_translation() {
 	return target_center - moved_center;
 }
 
-Vector3 QCP::move_to_weighted_center(PackedVector3Array &r_to_center, Vector<double> &r_weight) {
+Vector3 QCP::move_to_weighted_center(PackedVector3Array &r_to_center, Vector<ik_real_t> &r_weight) {
 	Vector3 center;
-	double total_weight = 0;
+	ik_real_t total_weight = 0;
 	bool weight_is_empty = r_weight.is_empty();
 	int size = r_to_center.size();
 
@@ -159,50 +163,77 @@ Vector3 QCP::move_to_weighted_center(PackedVector3Array &r_to_center, Vector<dou
 	return center;
 }
 
-void QCP::inner_product(PackedVector3Array &coords1, PackedVector3Array &coords2) {
-	Vector3 weighted_coord1, weighted_coord2;
-	double sum_of_squares1 = 0, sum_of_squares2 = 0;
-
-	sum_xx = 0;
-	sum_xy = 0;
-	sum_xz = 0;
-	sum_yx = 0;
-	sum_yy = 0;
-	sum_yz = 0;
-	sum_zx = 0;
-	sum_zy = 0;
-	sum_zz = 0;
-
-	bool weight_is_empty = weight.is_empty();
-	int size = coords1.size();
-
-	for (int i = 0; i < size; i++) {
-		if (!weight_is_empty) {
-			weighted_coord1 = weight[i] * coords1[i];
-			sum_of_squares1 += weighted_coord1.dot(coords1[i]);
-		} else {
-			weighted_coord1 = coords1[i];
-			sum_of_squares1 += weighted_coord1.dot(weighted_coord1);
-		}
-
-		weighted_coord2 = coords2[i];
-
-		sum_of_squares2 += weight_is_empty ? weighted_coord2.dot(weighted_coord2) : (weight[i] * weighted_coord2.dot(weighted_coord2));
-
-		sum_xx += (weighted_coord1.x * weighted_coord2.x);
-		sum_xy += (weighted_coord1.x * weighted_coord2.y);
-		sum_xz += (weighted_coord1.x * weighted_coord2.z);
+template <int32_t N>
+void QCP::_inner_product_kernel(const Vector3 *p_coords1, const Vector3 *p_coords2, const ik_real_t *p_weight, int32_t p_count) {
+	DEV_ASSERT(N == 0 || N == p_count);
+	const int32_t count = N > 0 ? N : p_count;
+	ik_real_t xx = 0, xy = 0, xz = 0, yx = 0, yy = 0, yz = 0, zx = 0, zy = 0, zz = 0;
+	ik_real_t sum_of_squares1 = 0, sum_of_squares2 = 0;
+
+	for (int32_t i = 0; i < count; i++) {
+		const ik_real_t w = p_weight ? p_weight[i] : ik_real_t(1.0);
+		const ik_real_t x1 = w * p_coords1[i].x;
+		const ik_real_t y1 = w * p_coords1[i].y;
+		const ik_real_t z1 = w * p_coords1[i].z;
+		const ik_real_t x2 = p_coords2[i].x;
+		const ik_real_t y2 = p_coords2[i].y;
+		const ik_real_t z2 = p_coords2[i].z;
+
+		sum_of_squares1 += x1 * p_coords1[i].x + y1 * p_coords1[i].y + z1 * p_coords1[i].z;
+		sum_of_squares2 += w * (x2 * x2 + y2 * y2 + z2 * z2);
+
+		xx += x1 * x2;
+		xy += x1 * y2;
+		xz += x1 * z2;
+
+		yx += y1 * x2;
+		yy += y1 * y2;
+		yz += y1 * z2;
+
+		zx += z1 * x2;
+		zy += z1 * y2;
+		zz += z1 * z2;
+	}
 
-		sum_yx += (weighted_coord1.y * weighted_coord2.x);
-		sum_yy += (weighted_coord1.y * weighted_coord2.y);
-		sum_yz += (weighted_coord1.y * weighted_coord2.z);
+	sum_xx = xx;
+	sum_xy = xy;
+	sum_xz = xz;
+	sum_yx = yx;
+	sum_yy = yy;
+	sum_yz = yz;
+	sum_zx = zx;
+	sum_zy = zy;
+	sum_zz = zz;
+	max_eigenvalue = (sum_of_squares1 + sum_of_squares2) * 0.5;
+}
 
-		sum_zx += (weighted_coord1.z * weighted_coord2.x);
-		sum_zy += (weighted_coord1.z * weighted_coord2.y);
-		sum_zz += (weighted_coord1.z * weighted_coord2.z);
+QCP::InnerProductKernel QCP::get_inner_product_kernel(int32_t p_heading_count) {
+	// An effector contributes 1, 3, 5 or 7 headings, so these cover single effectors and the common multi-effector segments.
+	switch (p_heading_count) {
+		case 3:
+			return &QCP::_inner_product_kernel<3>;
+		case 5:
+			return &QCP::_inner_product_kernel<5>;
+		case 7:
+			return &QCP::_inner_product_kernel<7>;
+		case 14:
+			return &QCP::_inner_product_kernel<14>;
+		case 21:
+			return &QCP::_inner_product_kernel<21>;
+		default:
+			return &QCP::_inner_product_kernel<0>;
 	}
+}
 
-	double initial_eigenvalue = (sum_of_squares1 + sum_of_squares2) * 0.5;
+void QCP::set_inner_product_kernel(InnerProductKernel p_kernel) {
+	inner_product_kernel = p_kernel;
+}
+
+void QCP::inner_product(PackedVector3Array &coords1, PackedVector3Array &coords2) {
+	int32_t size = coords1.size();
+	const ik_real_t *weight_ptr = weight.is_empty() ? nullptr : weight.ptr();
+	InnerProductKernel kernel = inner_product_kernel ? inner_product_kernel : get_inner_product_kernel(size);
+	(this->*kernel)(coords1.ptr(), coords2.ptr(), weight_ptr, size);
 
 	sum_xz_plus_zx = sum_xz + sum_zx;
 	sum_yz_plus_zy = sum_yz + sum_zy;
@@ -212,17 +243,87 @@ void QCP::inner_product(PackedVector3Array &coords1, PackedVector3Array &coords2
 	sum_xy_minus_yx = sum_xy - sum_yx;
 	sum_xx_plus_yy = sum_xx + sum_yy;
 	sum_xx_minus_yy = sum_xx - sum_yy;
-	max_eigenvalue = initial_eigenvalue;
+
+	eigenvalue_iterations = 0;
+	if (size > 1) {
+		refine_max_eigenvalue();
+	}
 
 	inner_product_calculated = true;
 }
 
-Quaternion QCP::weighted_superpose(PackedVector3Array &p_moved, PackedVector3Array &p_target, Vector<double> &p_weight, bool translate) {
+void QCP::refine_max_eigenvalue() {
+	// Coefficients of the characteristic polynomial P(x) = x^4 + c2 x^2 + c1 x + c0 of the key matrix, see Theobald (2005).
+	ik_real_t sum_xx2 = sum_xx * sum_xx;
+	ik_real_t sum_yy2 = sum_yy * sum_yy;
+	ik_real_t sum_zz2 = sum_zz * sum_zz;
+	ik_real_t sum_xy2 = sum_xy * sum_xy;
+	ik_real_t sum_yz2 = sum_yz * sum_yz;
+	ik_real_t sum_xz2 = sum_xz * sum_xz;
+	ik_real_t sum_yx2 = sum_yx * sum_yx;
+	ik_real_t sum_zy2 = sum_zy * sum_zy;
+	ik_real_t sum_zx2 = sum_zx * sum_zx;
+
+	ik_real_t sum_yz_zy_minus_yy_zz_2 = 2.0 * (sum_yz * sum_zy - sum_yy * sum_zz);
+	ik_real_t sum_xx2_yy2_zz2_yz2_zy2 = sum_yy2 + sum_zz2 - sum_xx2 + sum_yz2 + sum_zy2;
+	ik_real_t sum_xy2_xz2_yx2_zx2 = sum_xy2 + sum_xz2 - sum_yx2 - sum_zx2;
+
+	ik_real_t c2 = -2.0 * (sum_xx2 + sum_yy2 + sum_zz2 + sum_xy2 + sum_yx2 + sum_xz2 + sum_zx2 + sum_yz2 + sum_zy2);
+	ik_real_t c1 = 8.0 * (sum_xx * sum_yz * sum_zy + sum_yy * sum_zx * sum_xz + sum_zz * sum_xy * sum_yx - sum_xx * sum_yy * sum_zz - sum_yz * sum_zx * sum_xy - sum_zy * sum_yx * sum_xz);
+	ik_real_t c0 = sum_xy2_xz2_yx2_zx2 * sum_xy2_xz2_yx2_zx2 +
+			(sum_xx2_yy2_zz2_yz2_zy2 + sum_yz_zy_minus_yy_zz_2) * (sum_xx2_yy2_zz2_yz2_zy2 - sum_yz_zy_minus_yy_zz_2) +
+			(-sum_xz_plus_zx * sum_yz_minus_zy + sum_xy_minus_yx * (sum_xx_minus_yy - sum_zz)) * (-sum_xz_minus_zx * sum_yz_plus_zy + sum_xy_minus_yx * (sum_xx_minus_yy + sum_zz)) +
+			(-sum_xz_plus_zx * sum_yz_plus_zy - sum_xy_plus_yx * (sum_xx_plus_yy - sum_zz)) * (-sum_xz_minus_zx * sum_yz_minus_zy - sum_xy_plus_yx * (sum_xx_plus_yy + sum_zz)) +
+			(sum_xy_plus_yx * sum_yz_plus_zy + sum_xz_plus_zx * (sum_xx_minus_yy + sum_zz)) * (-sum_xy_minus_yx * sum_yz_minus_zy + sum_xz_plus_zx * (sum_xx_plus_yy + sum_zz)) +
+			(sum_xy_plus_yx * sum_yz_minus_zy + sum_xz_minus_zx * (sum_xx_minus_yy - sum_zz)) * (-sum_xy_minus_yx * sum_yz_plus_zy + sum_xz_minus_zx * (sum_xx_plus_yy - sum_zz));
+
+	// (G1 + G2) / 2 is an upper bound of the largest root, so Newton-Raphson converges to it monotonically.
+	// The squared roots sum to -2 c2, so sqrt(-2 c2) bounds it too. That bound is far tighter for headings that barely
+	// correlate, whose largest root sits near zero with multiplicity, where Newton-Raphson only converges linearly.
+	max_eigenvalue = MIN(max_eigenvalue, Math::sqrt(MAX(ik_real_t(-2.0) * c2, ik_real_t(0.0))));
+	for (int32_t i = 0; i < max_eigenvalue_iterations; i++) {
+		eigenvalue_iterations++;
+		ik_real_t previous_eigenvalue = max_eigenvalue;
+		ik_real_t eigenvalue_squared = max_eigenvalue * max_eigenvalue;
+		ik_real_t b = (eigenvalue_squared + c2) * max_eigenvalue;
+		ik_real_t a = b + c1;
+		ik_real_t derivative = 2.0 * eigenvalue_squared * max_eigenvalue + b + a;
+		if (derivative == 0.0) {
+			break;
+		}
+		max_eigenvalue -= (a * max_eigenvalue + c0) / derivative;
+		if (Math::abs(max_eigenvalue - previous_eigenvalue) < Math::abs(eigenvalue_precision * max_eigenvalue)) {
+			break;
+		}
+	}
+}
+
+void QCP::set_max_eigenvalue_iterations(int32_t p_max_iterations) {
+	max_eigenvalue_iterations = MAX(p_max_iterations, 0);
+}
+
+int32_t QCP::get_max_eigenvalue_iterations() const {
+	return max_eigenvalue_iterations;
+}
+
+void QCP::set_eigenvalue_precision(ik_real_t p_precision) {
+	eigenvalue_precision = p_precision;
+}
+
+ik_real_t QCP::get_eigenvalue_precision() const {
+	return eigenvalue_precision;
+}
+
+int32_t QCP::get_eigenvalue_iterations() const {
+	return eigenvalue_iterations;
+}
+
+Quaternion QCP::weighted_superpose(PackedVector3Array &p_moved, PackedVector3Array &p_target, Vector<ik_real_t> &p_weight, bool translate) {
 	set(p_moved, p_target, p_weight, translate);
 	return get_rotation();
 }
 
-void QCP::set(PackedVector3Array &p_moved, PackedVector3Array &p_target, Vector<double> &p_weight, bool p_translate) {
+void QCP::set(PackedVector3Array &p_moved, PackedVector3Array &p_target, Vector<ik_real_t> &p_weight, bool p_translate) {
 	transformation_calculated = false;
 	inner_product_calculated = false;
 
@@ -34,6 +34,7 @@
 #include "core/math/basis.h"
 #include "core/math/vector3.h"
 #include "core/variant/variant.h"
+#include "ik_precision.h"
 
 /**
  * Implementation of the Quaternion-Based Characteristic Polynomial algorithm
@@ -68,30 +69,53 @@
  */
 
 class QCP {
-	double eigenvector_precision = 1E-6;
+public:
+	typedef void (QCP::*InnerProductKernel)(const Vector3 *p_coords1, const Vector3 *p_coords2, const ik_real_t *p_weight, int32_t p_count);
+
+private:
+	ik_real_t eigenvector_precision = 1E-6;
+	ik_real_t eigenvalue_precision = IK_REAL_EPSILON;
+	int32_t max_eigenvalue_iterations = 50;
+	int32_t eigenvalue_iterations = 0;
+	InnerProductKernel inner_product_kernel = nullptr;
 
 	PackedVector3Array target, moved;
-	Vector<double> weight;
-	double w_sum = 0;
+	Vector<ik_real_t> weight;
+	ik_real_t w_sum = 0;
 
 	Vector3 target_center, moved_center;
 
-	double sum_xy = 0, sum_xz = 0, sum_yx = 0, sum_yz = 0, sum_zx = 0, sum_zy = 0;
-	double sum_xx_plus_yy = 0, sum_zz = 0, max_eigenvalue = 0, sum_yz_minus_zy = 0, sum_xz_minus_zx = 0, sum_xy_minus_yx = 0;
-	double sum_xx_minus_yy = 0, sum_xy_plus_yx = 0, sum_xz_plus_zx = 0;
-	double sum_yy = 0, sum_xx = 0, sum_yz_plus_zy = 0;
+	ik_real_t sum_xy = 0, sum_xz = 0, sum_yx = 0, sum_yz = 0, sum_zx = 0, sum_zy = 0;
+	ik_real_t sum_xx_plus_yy = 0, sum_zz = 0, max_eigenvalue = 0, sum_yz_minus_zy = 0, sum_xz_minus_zx = 0, sum_xy_minus_yx = 0;
+	ik_real_t sum_xx_minus_yy = 0, sum_xy_plus_yx = 0, sum_xz_plus_zx = 0;
+	ik_real_t sum_yy = 0, sum_xx = 0, sum_yz_plus_zy = 0;
 	bool transformation_calculated = false, inner_product_calculated = false;
 
 	void inner_product(PackedVector3Array &coords1, PackedVector3Array &coords2);
+	void refine_max_eigenvalue();
+	template <int32_t N>
+	void _inner_product_kernel(const Vector3 *p_coords1, const Vector3 *p_coords2, const ik_real_t *p_weight, int32_t p_count);
 	void set(PackedVector3Array &r_target, PackedVector3Array &r_moved);
 	Quaternion calculate_rotation();
-	void set(PackedVector3Array &p_moved, PackedVector3Array &p_target, Vector<double> &p_weight, bool p_translate);
+	void set(PackedVector3Array &p_moved, PackedVector3Array &p_target, Vector<ik_real_t> &p_weight, bool p_translate);
 	static void translate(Vector3 r_translate, PackedVector3Array &r_x);
-	Vector3 move_to_weighted_center(PackedVector3Array &r_to_center, Vector<double> &r_weight);
+	Vector3 move_to_weighted_center(PackedVector3Array &r_to_center, Vector<ik_real_t> &r_weight);
 
 public:
-	QCP(double p_evec_prec);
-	Quaternion weighted_superpose(PackedVector3Array &p_moved, PackedVector3Array &p_target, Vector<double> &p_weight, bool translate);
+	QCP(ik_real_t p_evec_prec);
+	// Returns an inner product kernel unrolled for p_heading_count headings, or the generic kernel if there is no specialization.
+	static InnerProductKernel get_inner_product_kernel(int32_t p_heading_count);
+	void set_inner_product_kernel(InnerProductKernel p_kernel);
+	// Closed-form superposition of a single heading: the rotation along the shortest arc from p_moved to p_target.
+	static Quaternion get_shortest_arc(const Vector3 &p_moved, const Vector3 &p_target);
+	// Newton-Raphson refinement of the largest eigenvalue. A cap of 0 keeps the initial (G1 + G2) / 2 estimate, which is only exact for noise free superpositions.
+	void set_max_eigenvalue_iterations(int32_t p_max_iterations);
+	int32_t get_max_eigenvalue_iterations() const;
+	void set_eigenvalue_precision(ik_real_t p_precision);
+	ik_real_t get_eigenvalue_precision() const;
+	// Newton-Raphson iterations spent by the last superposition.
+	int32_t get_eigenvalue_iterations() const;
+	Quaternion weighted_superpose(PackedVector3Array &p_moved, PackedVector3Array &p_target, Vector<ik_real_t> &p_weight, bool translate);
 	Quaternion get_rotation();
 	Vector3 get_translation();
 };
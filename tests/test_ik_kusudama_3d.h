@@ -291,6 +291,241 @@ TEST_CASE("[Modules][ManyBoneIK][IKKusudama3D] Check limit cones clear functiona
 	open_cones = kusudama->get_open_cones();
 	CHECK(open_cones.size() == 0); // Expect no limit cones to remain
 }
+
+TEST_CASE("[Modules][ManyBoneIK][IKKusudama3D] Value ray queries match IKRay3D") {
+	// The expected values were computed with the IKRay3D member functions before the value versions existed.
+	const Vector3 expected_intersection = Vector3(0.847107, -1.334711, 2.162810);
+	const Vector3 expected_point_1 = Vector3(1.333534, -2.037326, 2.811378);
+	const Vector3 expected_point_2 = Vector3(-1.833534, 2.537326, -1.411378);
+	const Vector3 expected_first = Vector3(-0.054758, -0.032016, 0.960322);
+	const Vector3 expected_second = Vector3(-0.655394, 0.835569, 0.159475);
+
+	Vector3 point_1 = Vector3(0.2, -0.4, 1.3);
+	Vector3 point_2 = Vector3(-0.7, 0.9, 0.1);
+	Ref<IKRay3D> ray = Ref<IKRay3D>(memnew(IKRay3D(point_1, point_2)));
+
+	Vector3 vertex_a = Vector3(1, 0, 0);
+	Vector3 vertex_b = Vector3(0, 1, 0.2);
+	Vector3 vertex_c = Vector3(0.3, 0.1, 1);
+	CHECK(IKRay3D::intersect_plane(point_1, point_2, vertex_a, vertex_b, vertex_c).distance_to(expected_intersection) < 1e-4);
+	CHECK(ray->get_intersects_plane(vertex_a, vertex_b, vertex_c).distance_to(expected_intersection) < 1e-4);
+
+	ray->elongate(2.5);
+	IKRay3D::elongate_segment(point_1, point_2, 2.5);
+	CHECK(point_1.distance_to(expected_point_1) < 1e-4);
+	CHECK(point_2.distance_to(expected_point_2) < 1e-4);
+	CHECK(ray->get_point_1().distance_to(expected_point_1) < 1e-4);
+	CHECK(ray->get_point_2().distance_to(expected_point_2) < 1e-4);
+
+	Vector3 ray_first, ray_second, value_first, value_second;
+	CHECK(ray->intersects_sphere(Vector3(0.1, 0.2, 0), 1.0, &ray_first, &ray_second) == 2);
+	CHECK(IKRay3D::intersect_sphere(point_1, point_2, Vector3(0.1, 0.2, 0), 1.0, &value_first, &value_second) == 2);
+	CHECK(ray_first.distance_to(expected_first) < 1e-4);
+	CHECK(ray_second.distance_to(expected_second) < 1e-4);
+	CHECK(value_first.distance_to(expected_first) < 1e-4);
+	CHECK(value_second.distance_to(expected_second) < 1e-4);
+}
+
+TEST_CASE("[Modules][ManyBoneIK][IKKusudama3D] Bounds queries return the expected closest points") {
+	Ref<IKKusudama3D> kusudama;
+	kusudama.instantiate();
+	const Vector3 control_points[] = { Vector3(0, 0, 1), Vector3(1, 0, 1).normalized() };
+	for (const Vector3 &control_point : control_points) {
+		Ref<IKLimitCone3D> cone;
+		cone.instantiate();
+		cone->set_attached_to(kusudama);
+		cone->set_radius(Math_PI / 8);
+		cone->set_control_point(control_point);
+		kusudama->add_open_cone(cone);
+	}
+	kusudama->update_tangent_radii();
+
+	// Inside the first cone, inside the second, on the path between them, then outside near each cone and behind both.
+	// The expected values were computed with the Vector overload before the pointer one existed.
+	const Vector3 points[] = { Vector3(0, 0, 1), Vector3(0.5, 0, 1), Vector3(0.4, 0.25, 1), Vector3(-0.2, 1, 0.1), Vector3(1, 0, -1), Vector3(-1, -1, 0.2) };
+	const Vector3 expected_points[] = {
+		Vector3(0, 0, 1),
+		Vector3(0.447214, 0, 0.894427),
+		Vector3(0.361773, 0.226108, 0.904431),
+		Vector3(-0.075050, 0.375252, 0.923880),
+		Vector3(0.923880, 0, 0.382683),
+		Vector3(-0.270598, -0.270598, 0.923880),
+	};
+	const double expected_in_bounds[] = { 1, 1, 1, -1, -1, -1 };
+	for (int32_t point_i = 0; point_i < 6; point_i++) {
+		Vector<double> bounds;
+		bounds.resize(1);
+		bounds.write[0] = 0;
+		Vector3 vector_result = kusudama->get_local_point_in_limits(points[point_i], &bounds);
+		double in_bounds = 0;
+		Vector3 pointer_result = kusudama->get_local_point_in_limits(points[point_i], &in_bounds);
+		CHECK(bounds[0] == expected_in_bounds[point_i]);
+		CHECK(in_bounds == expected_in_bounds[point_i]);
+		CHECK(vector_result.distance_to(expected_points[point_i]) < 1e-4);
+		CHECK(pointer_result.distance_to(expected_points[point_i]) < 1e-4);
+	}
+}
+
+TEST_CASE("[Modules][ManyBoneIK][IKKusudama3D] Orientation limit tests follow the tangent paths between cones") {
+	Ref<IKKusudama3D> kusudama;
+	kusudama.instantiate();
+	const Vector3 control_points[] = { Vector3(0, 0, 1), Vector3(1, 0, 0) };
+	for (const Vector3 &control_point : control_points) {
+		Ref<IKLimitCone3D> cone;
+		cone.instantiate();
+		cone->set_attached_to(kusudama);
+		cone->set_radius(0.3);
+		cone->set_control_point(control_point);
+		kusudama->add_open_cone(cone);
+	}
+	kusudama->update_tangent_radii();
+	// The same tolerance ManyBoneIK3D uses for its limit saturation.
+	const double tolerance = 1.0e-2;
+
+	// The first cone's edge facing the second opens onto the path between them, so it is not a limit.
+	CHECK_FALSE(kusudama->is_at_orientation_limit(Vector3(0, 0, 1).rotated(Vector3(0, 1, 0), 0.3), tolerance));
+	CHECK_FALSE(kusudama->is_at_orientation_limit(Vector3(1, 0, 1), tolerance));
+	CHECK(kusudama->is_at_orientation_limit(Vector3(-1, -1, 0.2), tolerance));
+
+	// A direction above the path is snapped onto the path's boundary, well away from either cone.
+	double in_bounds = 1.0;
+	Vector3 snapped = kusudama->get_local_point_in_limits(Vector3(1, 1, 1), &in_bounds);
+	REQUIRE(in_bounds < 0);
+	CHECK(snapped.angle_to(Vector3(0, 0, 1)) > 0.3 + 0.1);
+	CHECK(snapped.angle_to(Vector3(1, 0, 0)) > 0.3 + 0.1);
+	CHECK(kusudama->is_at_orientation_limit(snapped, tolerance));
+}
+
+TEST_CASE("[Modules][ManyBoneIK][IKKusudama3D] Fitted cones cover the sampled directions") {
+	// A swing from +Z over to +X, like an arm raised sideways.
+	PackedVector3Array directions;
+	for (int32_t sample_i = 0; sample_i <= 20; sample_i++) {
+		real_t angle = Math_PI / 2.0 * sample_i / 20.0;
+		directions.push_back(Vector3(Math::sin(angle), 0.05 * Math::sin(angle * 7.0), Math::cos(angle)).normalized());
+	}
+	const real_t max_radius = Math_PI / 8.0;
+	Vector<Vector4> cones = IKKusudama3D::fit_open_cones(directions, max_radius);
+	REQUIRE(cones.size() >= 2);
+	for (const Vector4 &cone : cones) {
+		CHECK(cone.w <= max_radius + CMP_EPSILON);
+	}
+	CHECK_MESSAGE(Vector3(cones[0].x, cones[0].y, cones[0].z).angle_to(directions[0]) < Vector3(cones[0].x, cones[0].y, cones[0].z).angle_to(directions[20]), "Cones follow the order of the motion.");
+	for (const Vector3 &direction : directions) {
+		bool covered = false;
+		for (const Vector4 &cone : cones) {
+			covered = covered || Vector3(cone.x, cone.y, cone.z).angle_to(direction) <= cone.w + CMP_EPSILON;
+		}
+		CHECK(covered);
+	}
+}
+
+TEST_CASE("[Modules][ManyBoneIK][IKKusudama3D] Simplifying drops contained and overlapping cones") {
+	Vector<Vector4> cones;
+	cones.push_back(Vector4(0, 0, 1, 0.5));
+	Vector3 inner_center = Vector3(0, 0.1, 1).normalized();
+	cones.push_back(Vector4(inner_center.x, inner_center.y, inner_center.z, 0.1));
+	cones.push_back(Vector4(1, 0, 0, 0.3));
+	Vector<Vector4> simplified = IKKusudama3D::simplify_open_cones(cones, 0.01);
+	REQUIRE(simplified.size() == 2);
+	CHECK(Math::is_equal_approx(simplified[0].w, real_t(0.5)));
+	CHECK(Math::is_equal_approx(simplified[1].w, real_t(0.3)));
+
+	Vector<Vector4> overlapping;
+	overlapping.push_back(Vector4(0, 0, 1, 0.4));
+	overlapping.push_back(Vector4(Math::sin(0.1), 0, Math::cos(0.1), 0.4));
+	Vector<Vector4> merged = IKKusudama3D::simplify_open_cones(overlapping, 0.06);
+	REQUIRE(merged.size() == 1);
+	CHECK(Math::is_equal_approx(merged[0].w, real_t(0.45)));
+}
+
+struct ConstrainedJoint {
+	Ref<IKNode3D> parent;
+	Ref<IKNode3D> to_set;
+	Ref<IKNode3D> bone_direction;
+	Ref<IKNode3D> limiting_axes;
+	Ref<IKNode3D> twist_axes;
+};
+
+// A joint bent and twisted well past a 0.4 radian cone and a quarter turn of twist.
+static ConstrainedJoint create_constrained_joint() {
+	ConstrainedJoint joint;
+	joint.parent.instantiate();
+	joint.parent->set_transform(Transform3D(Basis(Vector3(0, 0, 1), 0.3), Vector3(0, 1, 0)));
+	joint.to_set.instantiate();
+	joint.to_set->set_parent(joint.parent);
+	joint.to_set->set_transform(Transform3D(Basis::from_euler(Vector3(1.1, 0.9, -0.6)), Vector3(0, 1, 0)));
+	joint.bone_direction.instantiate();
+	joint.bone_direction->set_parent(joint.to_set);
+	joint.limiting_axes.instantiate();
+	joint.limiting_axes->set_parent(joint.parent);
+	joint.limiting_axes->set_transform(Transform3D(Basis(), Vector3(0, 1, 0)));
+	joint.twist_axes.instantiate();
+	joint.twist_axes->set_parent(joint.parent);
+	joint.twist_axes->set_transform(Transform3D(Basis(), Vector3(0, 1, 0)));
+	return joint;
+}
+
+TEST_CASE("[Modules][ManyBoneIK][IKKusudama3D] Fused constraint projection matches the two pass snap") {
+	Ref<IKKusudama3D> kusudama;
+	kusudama.instantiate();
+	kusudama->enable_orientational_limits();
+	Ref<IKLimitCone3D> cone;
+	cone.instantiate();
+	cone->set_attached_to(kusudama);
+	cone->set_control_point(Vector3(0, 1, 0));
+	cone->set_radius(0.4);
+	kusudama->add_open_cone(cone);
+	kusudama->update_tangent_radii();
+	kusudama->enable_axial_limits();
+	kusudama->set_axial_limits(-Math_PI / 4.0, Math_PI / 2.0);
+
+	ConstrainedJoint two_pass = create_constrained_joint();
+	kusudama->snap_to_orientation_limit(two_pass.bone_direction, two_pass.to_set, two_pass.limiting_axes, 0.0, 1.0);
+	kusudama->set_snap_to_twist_limit(two_pass.bone_direction, two_pass.to_set, two_pass.twist_axes, 0.0, 1.0);
+
+	ConstrainedJoint fused = create_constrained_joint();
+	Transform3D unconstrained = fused.to_set->get_transform();
+	kusudama->snap_to_limits(fused.bone_direction, fused.to_set, fused.limiting_axes, fused.twist_axes);
+
+	CHECK_FALSE(fused.to_set->get_transform().basis.is_equal_approx(unconstrained.basis));
+	CHECK(fused.to_set->get_transform().basis.is_equal_approx(two_pass.to_set->get_transform().basis));
+	CHECK(fused.to_set->get_transform().origin.is_equal_approx(unconstrained.origin));
+}
+
+TEST_CASE("[Modules][ManyBoneIK][IKKusudama3D] Fused constraint projection keeps the bone scale") {
+	Ref<IKKusudama3D> kusudama;
+	kusudama.instantiate();
+	kusudama->enable_orientational_limits();
+	Ref<IKLimitCone3D> cone;
+	cone.instantiate();
+	cone->set_attached_to(kusudama);
+	cone->set_control_point(Vector3(0, 1, 0));
+	cone->set_radius(0.4);
+	kusudama->add_open_cone(cone);
+	kusudama->update_tangent_radii();
+	kusudama->enable_axial_limits();
+	kusudama->set_axial_limits(-Math_PI / 4.0, Math_PI / 2.0);
+	const Vector3 scale = Vector3(1.5, 0.5, 2.0);
+
+	// Pointing down the cone and turned to the twist center, the joint is inside both limits and left exactly as it was.
+	ConstrainedJoint resting = create_constrained_joint();
+	Quaternion twist_min = IKKusudama3D::get_quaternion_axis_angle(Vector3(0, 1, 0), -Math_PI / 4.0);
+	Quaternion twist_center = Quaternion(Vector3(0, 0, 1), twist_min.xform(twist_min.xform(Vector3(0, 0, 1))));
+	resting.to_set->set_transform(Transform3D(Basis(twist_center).scaled_local(scale), Vector3(0, 1, 0)));
+	Transform3D rest = resting.to_set->get_transform();
+	kusudama->snap_to_limits(resting.bone_direction, resting.to_set, resting.limiting_axes, resting.twist_axes);
+	CHECK(resting.to_set->get_transform() == rest);
+
+	ConstrainedJoint scaled = create_constrained_joint();
+	Transform3D unconstrained = scaled.to_set->get_transform();
+	scaled.to_set->set_transform(Transform3D(unconstrained.basis.scaled_local(scale), unconstrained.origin));
+	kusudama->snap_to_limits(scaled.bone_direction, scaled.to_set, scaled.limiting_axes, scaled.twist_axes);
+	ConstrainedJoint unscaled = create_constrained_joint();
+	kusudama->snap_to_limits(unscaled.bone_direction, unscaled.to_set, unscaled.limiting_axes, unscaled.twist_axes);
+
+	CHECK(scaled.to_set->get_transform().basis.get_scale().is_equal_approx(scale));
+	CHECK(scaled.to_set->get_transform().basis.get_rotation_quaternion().is_equal_approx(unscaled.to_set->get_transform().basis.get_rotation_quaternion()));
+}
 } // namespace TestIKKusudama3D
 
 #endif // TEST_IK_KUSUDAMA_3D_H
@@ -104,6 +104,26 @@ TEST_CASE("[Modules][IKNode3D] Test local transform calculation") {
 
 	CHECK(node->get_transform() == expected_local_transform);
 }
+
+TEST_CASE("[Modules][IKNode3D] Deferred transform writes propagate once") {
+	Ref<IKNode3D> parent;
+	parent.instantiate();
+	Ref<IKNode3D> child;
+	child.instantiate();
+	child->set_parent(parent);
+
+	Transform3D child_transform;
+	child_transform.origin = Vector3(0.0, 1.0, 0.0);
+	CHECK(child->set_transform_deferred(child_transform));
+	CHECK_FALSE(child->set_transform_deferred(child_transform));
+
+	Transform3D parent_transform;
+	parent_transform.origin = Vector3(1.0, 0.0, 0.0);
+	CHECK(parent->set_transform_deferred(parent_transform));
+	parent->_propagate_transform_changed();
+
+	CHECK(child->get_global_transform().origin.is_equal_approx(Vector3(1.0, 1.0, 0.0)));
+}
 } // namespace TestIKNode3D
 
 #endif // TEST_IK_NODE_3D_H
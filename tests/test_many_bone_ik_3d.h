@@ -0,0 +1,803 @@
+/**************************************************************************/
+/*  test_many_bone_ik_3d.h                                                */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GODOT ENGINE                               */
+/*                        https://godotengine.org                         */
+/**************************************************************************/
+/* Copyright (c) 2014-present Godot Engine contributors (see AUTHORS.md). */
+/* Copyright (c) 2007-2014 Juan Linietsky, Ariel Manzur.                  */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef TEST_MANY_BONE_IK_3D_H
+#define TEST_MANY_BONE_IK_3D_H
+
+#include "core/io/dir_access.h"
+#include "core/io/file_access.h"
+#include "core/io/resource_saver.h"
+#include "core/object/worker_thread_pool.h"
+#include "core/os/os.h"
+#include "core/templates/hashfuncs.h"
+#include "modules/many_bone_ik/src/many_bone_ik_3d.h"
+#include "modules/many_bone_ik/src/many_bone_ik_3d_regression_runner.h"
+#include "modules/many_bone_ik/src/many_bone_ik_3d_state.h"
+#include "modules/many_bone_ik/src/math/qcp.h"
+#include "scene/3d/skeleton_3d.h"
+#include "scene/animation/animation_player.h"
+#include "scene/resources/animation_library.h"
+#include "scene/main/window.h"
+#include "scene/resources/packed_scene.h"
+#include "tests/test_macros.h"
+
+namespace TestManyBoneIK3D {
+
+struct TestRig {
+	Node3D *root = nullptr;
+	Skeleton3D *skeleton = nullptr;
+	ManyBoneIK3D *ik = nullptr;
+	Node3D *left_target = nullptr;
+	Node3D *right_target = nullptr;
+};
+
+// A spine that forks into two arms, so the solve has a parent segment with two pinned child segments.
+// With p_elbows, each arm gets a forearm, which makes the arm segments three bone chains.
+static TestRig create_rig(bool p_deterministic, bool p_elbows = false) {
+	TestRig rig;
+	rig.root = memnew(Node3D);
+	SceneTree::get_singleton()->get_root()->add_child(rig.root);
+
+	rig.skeleton = memnew(Skeleton3D);
+	const char *names[] = { "hips", "spine", "chest", "arm_l", "hand_l", "arm_r", "hand_r", "forearm_l", "forearm_r" };
+	const int32_t parents[] = { -1, 0, 1, 2, 3, 2, 5, 3, 5 };
+	const int32_t elbow_parents[] = { -1, 0, 1, 2, 7, 2, 8, 3, 5 };
+	const Vector3 offsets[] = { Vector3(), Vector3(0, 1, 0), Vector3(0, 1, 0), Vector3(0.5, 0.5, 0), Vector3(1, 0, 0), Vector3(-0.5, 0.5, 0), Vector3(-1, 0, 0), Vector3(0.5, 0, 0), Vector3(-0.5, 0, 0) };
+	const int32_t bone_count = p_elbows ? 9 : 7;
+	for (int32_t bone_i = 0; bone_i < bone_count; bone_i++) {
+		rig.skeleton->add_bone(names[bone_i]);
+	}
+	for (int32_t bone_i = 0; bone_i < bone_count; bone_i++) {
+		rig.skeleton->set_bone_parent(bone_i, p_elbows ? elbow_parents[bone_i] : parents[bone_i]);
+		// The forearm takes the first half of the arm, so the hands rest where they do without elbows.
+		Vector3 offset = p_elbows && (bone_i == 4 || bone_i == 6) ? offsets[bone_i] * 0.5 : offsets[bone_i];
+		rig.skeleton->set_bone_rest(bone_i, Transform3D(Basis(), offset));
+	}
+	rig.skeleton->reset_bone_poses();
+	rig.root->add_child(rig.skeleton);
+
+	rig.left_target = memnew(Node3D);
+	rig.root->add_child(rig.left_target);
+	rig.right_target = memnew(Node3D);
+	rig.root->add_child(rig.right_target);
+
+	rig.ik = memnew(ManyBoneIK3D);
+	rig.skeleton->add_child(rig.ik);
+	rig.ik->set_deterministic(p_deterministic);
+	rig.ik->set("pin_count", 2);
+	rig.ik->set_effector_bone_name(0, "hand_l");
+	rig.ik->set_effector_bone_name(1, "hand_r");
+	rig.ik->set_effector_target_node_path(0, rig.ik->get_path_to(rig.left_target));
+	rig.ik->set_effector_target_node_path(1, rig.ik->get_path_to(rig.right_target));
+	rig.ik->set_pin_weight(0, 1.0);
+	rig.ik->set_pin_weight(1, 1.0);
+	return rig;
+}
+
+// A single unbranched chain of p_bone_count bones. The first bone is pinned in place to right_target and does not pull on the
+// rest of the chain, so every other bone sits in a rotation only child segment that is pinned at its tip to left_target.
+static TestRig create_chain_rig(int32_t p_bone_count) {
+	TestRig rig;
+	rig.root = memnew(Node3D);
+	SceneTree::get_singleton()->get_root()->add_child(rig.root);
+
+	rig.skeleton = memnew(Skeleton3D);
+	for (int32_t bone_i = 0; bone_i < p_bone_count; bone_i++) {
+		rig.skeleton->add_bone("link_" + itos(bone_i));
+		rig.skeleton->set_bone_parent(bone_i, bone_i - 1);
+		rig.skeleton->set_bone_rest(bone_i, Transform3D(Basis(), bone_i == 0 ? Vector3() : Vector3(0, 0.25, 0)));
+	}
+	rig.skeleton->reset_bone_poses();
+	rig.root->add_child(rig.skeleton);
+
+	rig.left_target = memnew(Node3D);
+	rig.root->add_child(rig.left_target);
+	rig.right_target = memnew(Node3D);
+	rig.root->add_child(rig.right_target);
+
+	rig.ik = memnew(ManyBoneIK3D);
+	rig.skeleton->add_child(rig.ik);
+	rig.ik->set_deterministic(true);
+	rig.ik->set("pin_count", 2);
+	rig.ik->set_effector_bone_name(0, "link_" + itos(p_bone_count - 1));
+	rig.ik->set_effector_bone_name(1, "link_0");
+	rig.ik->set_effector_target_node_path(0, rig.ik->get_path_to(rig.left_target));
+	rig.ik->set_effector_target_node_path(1, rig.ik->get_path_to(rig.right_target));
+	rig.ik->set_pin_weight(0, 1.0);
+	rig.ik->set_pin_weight(1, 1.0);
+	rig.ik->set_pin_motion_propagation_factor(1, 0.0);
+	return rig;
+}
+
+// A spine that ends in p_limb_count limbs spread around it. Each limb is a chain of p_link_count bones that forks into two digits
+// of p_link_count bones, and every digit tip is pinned to its own target. The rig has 2 + 3 * p_limb_count * p_link_count bones.
+static TestRig create_creature_rig(int32_t p_limb_count, int32_t p_link_count) {
+	TestRig rig;
+	rig.root = memnew(Node3D);
+	SceneTree::get_singleton()->get_root()->add_child(rig.root);
+
+	rig.skeleton = memnew(Skeleton3D);
+	rig.skeleton->add_bone("spine");
+	rig.skeleton->add_bone("chest");
+	rig.skeleton->set_bone_parent(1, 0);
+	rig.skeleton->set_bone_rest(1, Transform3D(Basis(), Vector3(0, 1, 0)));
+	Vector<String> digit_tips;
+	for (int32_t limb_i = 0; limb_i < p_limb_count; limb_i++) {
+		const real_t angle = Math_TAU * limb_i / p_limb_count;
+		const Vector3 limb_direction = Vector3(Math::cos(angle), 0, Math::sin(angle));
+		const Vector3 digit_directions[] = { (limb_direction + Vector3(0, 0.5, 0)).normalized(), (limb_direction - Vector3(0, 0.5, 0)).normalized() };
+		BoneId fork = 1;
+		for (int32_t link_i = 0; link_i < p_link_count; link_i++) {
+			BoneId bone = rig.skeleton->get_bone_count();
+			rig.skeleton->add_bone(vformat("limb_%d_%d", limb_i, link_i));
+			rig.skeleton->set_bone_parent(bone, fork);
+			rig.skeleton->set_bone_rest(bone, Transform3D(Basis(), limb_direction * 0.25));
+			fork = bone;
+		}
+		for (int32_t digit_i = 0; digit_i < 2; digit_i++) {
+			BoneId parent = fork;
+			for (int32_t link_i = 0; link_i < p_link_count; link_i++) {
+				BoneId bone = rig.skeleton->get_bone_count();
+				rig.skeleton->add_bone(vformat("digit_%d_%d_%d", limb_i, digit_i, link_i));
+				rig.skeleton->set_bone_parent(bone, parent);
+				rig.skeleton->set_bone_rest(bone, Transform3D(Basis(), digit_directions[digit_i] * 0.25));
+				parent = bone;
+			}
+			digit_tips.push_back(rig.skeleton->get_bone_name(parent));
+		}
+	}
+	rig.skeleton->reset_bone_poses();
+	rig.root->add_child(rig.skeleton);
+
+	rig.ik = memnew(ManyBoneIK3D);
+	rig.skeleton->add_child(rig.ik);
+	rig.ik->set_deterministic(true);
+	rig.ik->set("pin_count", digit_tips.size());
+	for (int32_t pin_i = 0; pin_i < digit_tips.size(); pin_i++) {
+		Node3D *target = memnew(Node3D);
+		rig.root->add_child(target);
+		rig.ik->set_effector_bone_name(pin_i, digit_tips[pin_i]);
+		rig.ik->set_effector_target_node_path(pin_i, rig.ik->get_path_to(target));
+		rig.ik->set_pin_weight(pin_i, 1.0);
+	}
+	rig.left_target = Object::cast_to<Node3D>(rig.ik->get_node(rig.ik->get_effector_target_node_path(0)));
+	rig.right_target = Object::cast_to<Node3D>(rig.ik->get_node(rig.ik->get_effector_target_node_path(1)));
+	return rig;
+}
+
+static void free_rig(TestRig &r_rig) {
+	memdelete(r_rig.root);
+	r_rig = TestRig();
+}
+
+static void set_targets(TestRig &r_rig, real_t p_phase) {
+	r_rig.left_target->set_position(Vector3(1.5, 2.0 + Math::sin(p_phase), 0.5 * Math::cos(p_phase)));
+	r_rig.right_target->set_position(Vector3(-1.5, 2.0 - Math::sin(p_phase), 0.5 * Math::cos(p_phase)));
+}
+
+// Hashes the raw bits of every IK bone pose.
+static uint32_t hash_poses(TestRig &r_rig) {
+	uint32_t hash = HASH_MURMUR3_SEED;
+	for (const Ref<IKBone3D> &bone : r_rig.ik->get_bone_list()) {
+		Transform3D pose = bone->get_pose();
+		hash = hash_murmur3_one_32(bone->get_bone_id(), hash);
+		hash = hash_murmur3_buffer(&pose, sizeof(Transform3D), hash);
+	}
+	return hash;
+}
+
+// Runs the skeleton's modifier stack once and hashes the solved bone poses.
+static uint32_t solve_and_hash(TestRig &r_rig) {
+	r_rig.skeleton->notification(Skeleton3D::NOTIFICATION_UPDATE_SKELETON);
+	return hash_poses(r_rig);
+}
+
+// Solves p_frames frames and returns the largest distance between a pinned bone and its target.
+static real_t solve_and_measure(TestRig &r_rig, int32_t p_frames) {
+	for (int32_t frame_i = 0; frame_i < p_frames; frame_i++) {
+		solve_and_hash(r_rig);
+	}
+	real_t error = 0.0;
+	for (const Ref<IKBone3D> &bone : r_rig.ik->get_bone_list()) {
+		if (!bone->is_pinned()) {
+			continue;
+		}
+		Node3D *target = Object::cast_to<Node3D>(r_rig.ik->get_node(bone->get_pin()->get_target_node()));
+		error = MAX(error, bone->get_global_pose().origin.distance_to(target->get_position()));
+	}
+	return error;
+}
+
+// Puts every target where its bone ends up in a bent pose, then returns the skeleton to rest, so an exact solution exists.
+static void set_reachable_targets(TestRig &r_rig, real_t p_bend = 0.3) {
+	for (int32_t bone_i = 1; bone_i < r_rig.skeleton->get_bone_count(); bone_i++) {
+		Vector3 axis = Vector3(Math::sin(real_t(bone_i)), 0.5, Math::cos(real_t(bone_i))).normalized();
+		r_rig.skeleton->set_bone_pose_rotation(bone_i, Quaternion(axis, p_bend));
+	}
+	for (int32_t effector_i = 0; effector_i < r_rig.ik->get_effector_count(); effector_i++) {
+		Node3D *target = Object::cast_to<Node3D>(r_rig.ik->get_node(r_rig.ik->get_effector_target_node_path(effector_i)));
+		BoneId bone = r_rig.skeleton->find_bone(r_rig.ik->get_effector_bone_name(effector_i));
+		target->set_transform(r_rig.skeleton->get_bone_global_pose(bone));
+	}
+	r_rig.skeleton->reset_bone_poses();
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Deterministic solves only depend on the current inputs") {
+	TestRig animated = create_rig(true);
+	uint32_t animated_hash = 0;
+	for (int32_t frame_i = 0; frame_i <= 10; frame_i++) {
+		set_targets(animated, frame_i * 0.3);
+		animated_hash = solve_and_hash(animated);
+	}
+	CHECK_MESSAGE(solve_and_hash(animated) == animated_hash, "Solving the same inputs again must give the same poses.");
+
+	TestRig fresh = create_rig(true);
+	set_targets(fresh, 10 * 0.3);
+	CHECK_MESSAGE(solve_and_hash(fresh) == animated_hash, "A fresh rig must reach the same poses as one that got there through other frames.");
+
+	free_rig(animated);
+	free_rig(fresh);
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Restoring a captured state restores the solve") {
+	TestRig rig = create_rig(false);
+	set_targets(rig, 0.0);
+	solve_and_hash(rig);
+	Ref<ManyBoneIK3DState> state = rig.ik->get_state();
+	CHECK(state->get_bone_count() == rig.ik->get_bone_list().size());
+	CHECK(state->get_effector_count() == 2);
+	uint32_t captured_hash = solve_and_hash(rig);
+	rig.ik->set_state(state);
+	CHECK_MESSAGE(solve_and_hash(rig) == captured_hash, "Solving from a restored state must repeat the solve that followed the capture.");
+
+	// A deterministic solve reads its targets before every solve; the restored ones must still be the ones solved toward.
+	free_rig(rig);
+	rig = create_rig(true);
+	set_targets(rig, 0.0);
+	solve_and_hash(rig);
+	rig.ik->capture_state(state);
+	captured_hash = solve_and_hash(rig);
+	set_targets(rig, 1.0);
+	const Transform3D spine_pose = rig.skeleton->get_bone_pose(rig.skeleton->find_bone("spine"));
+	rig.ik->set_state(state);
+	CHECK_MESSAGE(rig.skeleton->get_bone_pose(rig.skeleton->find_bone("spine")) == spine_pose, "Restoring must leave writing the skeleton to the next solve.");
+	CHECK(solve_and_hash(rig) == captured_hash);
+	CHECK_MESSAGE(solve_and_hash(rig) != captured_hash, "Only the first solve after a restore keeps the restored targets.");
+
+	Ref<ManyBoneIK3DState> pooled;
+	pooled.instantiate();
+	pooled->copy_from(state);
+	CHECK(pooled->get_bone_count() == state->get_bone_count());
+	for (int32_t bone_i = 0; bone_i < state->get_bone_count(); bone_i++) {
+		CHECK(pooled->get_bone_id(bone_i) == state->get_bone_id(bone_i));
+		CHECK(pooled->get_bone_pose(bone_i) == state->get_bone_pose(bone_i));
+	}
+	free_rig(rig);
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Reachability queries leave the live pose untouched") {
+	TestRig rig = create_rig(false);
+	set_targets(rig, 0.0);
+	solve_and_hash(rig);
+	uint32_t live_hash = hash_poses(rig);
+	Vector<Transform3D> skeleton_poses;
+	for (int32_t bone_i = 0; bone_i < rig.skeleton->get_bone_count(); bone_i++) {
+		skeleton_poses.push_back(rig.skeleton->get_bone_pose(bone_i));
+	}
+
+	PackedVector3Array candidates;
+	candidates.push_back(Vector3(1.2, 2.6, 0.3));
+	candidates.push_back(Vector3(1.0, 3.0, -0.4));
+	candidates.push_back(Vector3(40.0, 2.0, 0.0));
+	const Ref<IKNode3D> live_skeleton_transform = rig.ik->get_godot_skeleton_transform();
+	PackedVector2Array results = rig.ik->query_reachability(0, candidates, 10);
+	REQUIRE(results.size() == candidates.size());
+	CHECK_MESSAGE(rig.ik->get_godot_skeleton_transform() == live_skeleton_transform, "Queries must not replace the live skeleton transform.");
+	// The root segment translates, so the far target drags the whole rig toward it rather than leaving the arm's span short.
+	// The right hand's pin pulls back as hard, so the two split the distance.
+	const real_t far_distance = candidates[2].distance_to(rig.skeleton->get_bone_global_pose(rig.skeleton->find_bone("hand_l")).origin);
+	CHECK_MESSAGE(results[2].x < far_distance * 0.6, vformat("The far target was left %f of %f away.", results[2].x, far_distance));
+	CHECK(results[0].x < results[2].x);
+	CHECK(results[1].x < results[2].x);
+	for (const Vector2 &result : results) {
+		CHECK(result.y >= 0.0);
+		CHECK(result.y <= 1.0);
+	}
+
+	CHECK_MESSAGE(hash_poses(rig) == live_hash, "Queries must not change the solver's bones.");
+	for (int32_t bone_i = 0; bone_i < rig.skeleton->get_bone_count(); bone_i++) {
+		CHECK(rig.skeleton->get_bone_pose(bone_i) == skeleton_poses[bone_i]);
+	}
+	free_rig(rig);
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Rebuilding the rig reuses its solver transforms") {
+	TestRig rig = create_rig(true);
+	set_targets(rig, 0.0);
+	const uint32_t hash = solve_and_hash(rig);
+	// Four transforms per bone and the origin the root bone hangs from, then a pivot and an end for each arm's virtual bone
+	// in the coarse skeleton and the origin they hang from.
+	const uint32_t pooled_nodes = rig.ik->get_node_pool()->size();
+	const uint32_t virtual_bones = rig.ik->get_segmented_skeletons()[0]->get_child_segments().size();
+	CHECK(virtual_bones == 2);
+	CHECK(pooled_nodes == uint32_t(4 * rig.ik->get_bone_list().size() + 1 + 2 * virtual_bones + 1));
+	for (int32_t rebuild_i = 0; rebuild_i < 3; rebuild_i++) {
+		rig.ik->set_dirty();
+		CHECK_MESSAGE(solve_and_hash(rig) == hash, "A rig built from reused transforms must solve like a fresh one.");
+		CHECK_MESSAGE(rig.ik->get_node_pool()->size() == pooled_nodes, "The discarded rig's transforms must be reused.");
+	}
+	free_rig(rig);
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Reading the skeleton refreshes every bone below a changed one") {
+	TestRig rig = create_rig(false, true);
+	set_targets(rig, 0.0);
+	solve_and_hash(rig);
+	// The solver reads the skeleton back after each solve. Start from a read that matches it, with every global pose cached.
+	rig.ik->emit_signal("modification_processed");
+	for (const Ref<IKBone3D> &bone : rig.ik->get_bone_list()) {
+		bone->get_global_pose();
+	}
+	// One changed bone in the parent segment, and another further down an arm, inside the first one's subtree.
+	rig.skeleton->set_bone_pose_rotation(rig.skeleton->find_bone("spine"), Quaternion(Vector3(1, 0, 0), 0.4));
+	rig.skeleton->set_bone_pose_rotation(rig.skeleton->find_bone("forearm_l"), Quaternion(Vector3(0, 0, 1), -0.5));
+	rig.ik->emit_signal("modification_processed");
+	for (const Ref<IKBone3D> &bone : rig.ik->get_bone_list()) {
+		CHECK_MESSAGE(bone->get_global_pose().is_equal_approx(rig.skeleton->get_bone_global_pose(bone->get_bone_id())), vformat("Bone %d was not refreshed.", bone->get_bone_id()));
+	}
+	free_rig(rig);
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Analytic chains bend their joint toward the pole") {
+	TestRig rig = create_rig(true, true);
+	rig.ik->set_analytic_short_chains(true);
+	rig.ik->set_iterations_per_frame(30);
+	Node3D *pole = memnew(Node3D);
+	rig.root->add_child(pole);
+	rig.ik->set_pin_pole_node_path(0, rig.ik->get_path_to(pole));
+	// The hands rest one unit out with the arms straight, so both targets need the elbows to bend.
+	rig.left_target->set_position(Vector3(1.1, 2.6, 0.2));
+	rig.right_target->set_position(Vector3(-1.1, 2.6, 0.2));
+	const BoneId elbow = rig.skeleton->find_bone("forearm_l");
+	const real_t pole_sides[] = { -1.0, 1.0 };
+	for (const real_t pole_side : pole_sides) {
+		pole->set_position(Vector3(0.8, 2.5, 3.0 * pole_side));
+		CHECK(solve_and_measure(rig, 1) < 0.01);
+		Ref<IKBone3D> elbow_bone;
+		for (const Ref<IKBone3D> &bone : rig.ik->get_bone_list()) {
+			if (bone->get_bone_id() == elbow) {
+				elbow_bone = bone;
+			}
+		}
+		REQUIRE(elbow_bone.is_valid());
+		// The elbow must sit off the shoulder to hand line on the pole's side.
+		const Vector3 shoulder = elbow_bone->get_parent()->get_global_pose().origin;
+		const Vector3 axis = (rig.left_target->get_position() - shoulder).normalized();
+		Vector3 offset = elbow_bone->get_global_pose().origin - shoulder;
+		offset -= axis * axis.dot(offset);
+		Vector3 pole_offset = pole->get_position() - shoulder;
+		pole_offset -= axis * axis.dot(pole_offset);
+		CHECK_MESSAGE(offset.normalized().dot(pole_offset.normalized()) > 0.99, vformat("The elbow turned %f away from the pole.", offset.angle_to(pole_offset)));
+	}
+	// The right arm has no pole and still reaches its target, bending in the plane of its current pose.
+	for (const Ref<IKBoneSegment3D> &segment : rig.ik->get_segmented_skeletons()) {
+		for (const Ref<IKBoneSegment3D> &child : segment->get_child_segments()) {
+			CHECK(child->get_solver_engine() == IKBoneSegment3D::SOLVER_ENGINE_ANALYTIC);
+		}
+	}
+	free_rig(rig);
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] The FABRIK engine reaches targets on unconstrained arms") {
+	TestRig rig = create_rig(true);
+	rig.ik->set_fabrik_unconstrained_chains(true);
+	rig.left_target->set_position(Vector3(1.2, 2.9, 0.3));
+	rig.right_target->set_position(Vector3(-1.2, 2.9, 0.3));
+	solve_and_hash(rig);
+
+	int32_t fabrik_segments = 0;
+	for (const Ref<IKBoneSegment3D> &segment : rig.ik->get_segmented_skeletons()) {
+		CHECK_MESSAGE(segment->get_solver_engine() == IKBoneSegment3D::SOLVER_ENGINE_QCP, "The root segment translates the rig and must stay on QCP.");
+		for (const Ref<IKBoneSegment3D> &child : segment->get_child_segments()) {
+			if (child->get_solver_engine() == IKBoneSegment3D::SOLVER_ENGINE_FABRIK) {
+				fabrik_segments++;
+			}
+		}
+	}
+	CHECK(fabrik_segments == 2);
+	CHECK(solve_and_measure(rig, 10) < 0.05);
+	for (const Ref<IKBone3D> &bone : rig.ik->get_bone_list()) {
+		if (bone->is_pinned()) {
+			// FABRIK moves joint positions directly, so the rotations it converts them back to must keep the forearm length.
+			const real_t length = bone->get_global_pose().origin.distance_to(bone->get_parent()->get_global_pose().origin);
+			CHECK(Math::is_equal_approx(length, real_t(1.0), real_t(1e-3)));
+		}
+	}
+	free_rig(rig);
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Jacobi iterations converge on a long chain") {
+	const int32_t bone_count = 17;
+	const int32_t iterations[] = { 20, 20, 80, 160 };
+	real_t error[4];
+	uint32_t hashes[4];
+	for (int32_t run_i = 0; run_i < 4; run_i++) {
+		TestRig rig = create_chain_rig(bone_count);
+		rig.ik->set_iteration_scheme(run_i == 0 ? ManyBoneIK3D::ITERATION_SCHEME_GAUSS_SEIDEL : ManyBoneIK3D::ITERATION_SCHEME_JACOBI);
+		rig.ik->set_iterations_per_frame(iterations[run_i]);
+		rig.left_target->set_position(Vector3(1.5, 2.5, 0.5));
+		// Deterministic rigs start every frame from the input pose, so one frame runs exactly the set iterations.
+		error[run_i] = solve_and_measure(rig, 1);
+		hashes[run_i] = hash_poses(rig);
+		for (const Ref<IKBoneSegment3D> &segment : rig.ik->get_segmented_skeletons()) {
+			REQUIRE(segment->get_child_segments().size() == 1);
+			Vector<Ref<IKBone3D>> chain_bones;
+			segment->get_child_segments()[0]->create_bone_list(chain_bones);
+			CHECK(chain_bones.size() == bone_count - 1);
+		}
+		free_rig(rig);
+	}
+	CHECK(error[0] < 0.05);
+	// Every Jacobi bone applies only its share of the rotation, so the scheme needs more iterations than the
+	// sequential one, but the residual must keep shrinking instead of overshooting the target.
+	CHECK_MESSAGE(error[2] < error[1], vformat("Jacobi residual %f after 80 iterations against %f after 20.", error[2], error[1]));
+	CHECK_MESSAGE(error[3] < error[2], vformat("Jacobi residual %f after 160 iterations against %f after 80.", error[3], error[2]));
+	CHECK(error[3] < 0.05);
+
+	// The 16 bone segment solves its bones on worker threads; each bone writes only its own result, so the solve stays deterministic.
+	TestRig rig = create_chain_rig(bone_count);
+	rig.ik->set_iteration_scheme(ManyBoneIK3D::ITERATION_SCHEME_JACOBI);
+	rig.ik->set_iterations_per_frame(20);
+	rig.left_target->set_position(Vector3(1.5, 2.5, 0.5));
+	solve_and_measure(rig, 1);
+	CHECK(hash_poses(rig) == hashes[1]);
+	free_rig(rig);
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Stabilized trials never commit a worse pose") {
+	TestRig rig = create_rig(true);
+	rig.ik->set_stabilization_passes(3);
+	// A tight cone and twist on the spine keep it from following targets far above and behind the rig, so its trials can score worse than where they started.
+	rig.ik->set("constraint_count", 1);
+	rig.ik->set("constraints/0/bone_name", "spine");
+	rig.ik->set_kusudama_open_cone_count(0, 1);
+	rig.ik->set_kusudama_open_cone_center(0, 0, Vector3(0, 1, 0));
+	rig.ik->set_kusudama_open_cone_radius(0, 0, 0.05);
+	rig.ik->set_joint_twist(0, Vector2(0.0, 0.05));
+	rig.left_target->set_position(Vector3(4.0, 6.0, -5.0));
+	rig.right_target->set_position(Vector3(3.0, 7.0, -6.0));
+	solve_and_hash(rig);
+
+	// Only the root segment stabilizes. Step its bones one at a time, so every trial's starting score can be read.
+	Ref<IKBoneSegment3D> segment = rig.ik->get_segmented_skeletons()[0];
+	Vector<Ref<IKBone3D>> bones;
+	segment->create_bone_list(bones);
+	REQUIRE(bones.size() == 3);
+	for (int32_t iteration_i = 0; iteration_i < 10; iteration_i++) {
+		for (const Ref<IKBone3D> &bone : bones) {
+			const ik_real_t start_deviation = segment->get_bone_deviation(bone);
+			segment->solve_bone(bone, 0.0, false);
+			CHECK_MESSAGE(segment->get_previous_deviation() <= start_deviation, vformat("Bone %s committed a worse pose.", bone->get_name()));
+		}
+	}
+	free_rig(rig);
+
+	rig = create_rig(true);
+	rig.ik->set_stabilization_passes(3);
+	rig.left_target->set_position(Vector3(1.2, 2.9, 0.3));
+	rig.right_target->set_position(Vector3(-1.2, 2.9, 0.3));
+	CHECK_MESSAGE(solve_and_measure(rig, 1) < 0.1, "Halved retries must still let reachable targets be reached.");
+	free_rig(rig);
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Coarse passes let fewer full iterations reach the targets") {
+	// Four forked limbs of eight bone chains: the reduced skeleton has twelve virtual bones in two levels below the spine.
+	const int32_t coarse_iterations[] = { 0, 0, 8 };
+	const int32_t full_iterations[] = { 4, 8, 4 };
+	real_t error[3];
+	for (int32_t run_i = 0; run_i < 3; run_i++) {
+		TestRig rig = create_creature_rig(4, 8);
+		set_reachable_targets(rig, 0.05);
+		rig.ik->set_coarse_iterations(coarse_iterations[run_i]);
+		rig.ik->set_iterations_per_frame(full_iterations[run_i]);
+		error[run_i] = solve_and_measure(rig, 1);
+		if (coarse_iterations[run_i] > 0) {
+			REQUIRE(rig.ik->get_segmented_skeletons().size() == 1);
+			CHECK(rig.ik->get_segmented_skeletons()[0]->get_child_segments().size() == 4);
+			uint32_t hash = hash_poses(rig);
+			CHECK_MESSAGE(solve_and_hash(rig) == hash, "Solving the same inputs again must give the same poses.");
+		}
+		free_rig(rig);
+	}
+	CHECK_MESSAGE(error[2] < error[0], vformat("Coarse passes left %f against %f without them.", error[2], error[0]));
+	CHECK_MESSAGE(error[2] < error[1], vformat("Coarse passes with half the full iterations left %f against %f.", error[2], error[1]));
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] The regression runner writes one row per bone and frame") {
+	TestRig rig = create_rig(true);
+	set_targets(rig, 0.0);
+	rig.skeleton->set_owner(rig.root);
+	rig.left_target->set_owner(rig.root);
+	rig.right_target->set_owner(rig.root);
+	rig.ik->set_owner(rig.root);
+	// A second node on the same skeleton runs on top of the first every frame and gets rows of its own.
+	ManyBoneIK3D *second_ik = memnew(ManyBoneIK3D);
+	second_ik->set_name("SecondIK");
+	rig.skeleton->add_child(second_ik);
+	second_ik->set_owner(rig.root);
+	second_ik->set_deterministic(true);
+	second_ik->set("pin_count", 1);
+	second_ik->set_effector_bone_name(0, "hand_l");
+	second_ik->set_effector_target_node_path(0, second_ik->get_path_to(rig.left_target));
+	second_ik->set_pin_weight(0, 1.0);
+	Ref<PackedScene> packed_scene;
+	packed_scene.instantiate();
+	REQUIRE(packed_scene->pack(rig.root) == OK);
+	const String scene_path = OS::get_singleton()->get_cache_path().path_join("many_bone_ik_regression_test.tscn");
+	const String output_path = OS::get_singleton()->get_cache_path().path_join("many_bone_ik_regression_test.csv");
+	REQUIRE(ResourceSaver::save(packed_scene, scene_path) == OK);
+	// Every bone of the forked rig lies on the path to a pin, so each one is solved and recorded.
+	const int32_t bone_count = rig.skeleton->get_bone_count();
+	free_rig(rig);
+
+	Ref<ManyBoneIK3DRegressionRunner> runner;
+	runner.instantiate();
+	const int32_t frame_count = 3;
+	REQUIRE(runner->run_scene(scene_path, output_path, frame_count) == OK);
+	Vector<String> lines = FileAccess::get_file_as_string(output_path).split("\n", false);
+	REQUIRE(lines.size() > 0);
+	CHECK(lines[0] == "frame,usec,node,bone,px,py,pz,qx,qy,qz,qw");
+	CHECK(lines.size() > 1 + frame_count * bone_count);
+	CHECK(lines[lines.size() - 1].begins_with(itos(frame_count - 1) + ","));
+	CHECK(lines[lines.size() - 1].contains("SecondIK"));
+	DirAccess::remove_absolute(scene_path);
+	DirAccess::remove_absolute(output_path);
+}
+
+// Reachable targets have an exact solution, so the residual after converging is the error the solver's scalar type adds.
+// Measured on the two rigs below after 1000 to 4000 iterations, the residual peaked at 6.0e-5 in double precision and
+// 1.1e-4 in single precision; each tolerance leaves about twice that.
+#ifdef MANY_BONE_IK_SINGLE_PRECISION
+static const real_t SOLVE_PRECISION_TOLERANCE = 2.5e-4;
+#else
+static const real_t SOLVE_PRECISION_TOLERANCE = 1e-4;
+#endif
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Converged solves stay within the precision tolerance") {
+	// The forked rig and a 16 bone chain, so both short and long accumulations of per-bone rounding are covered.
+	for (int32_t rig_i = 0; rig_i < 2; rig_i++) {
+		TestRig rig = rig_i == 0 ? create_rig(true) : create_chain_rig(17);
+		// Position only pins, so the residual measures the solve rather than a trade-off against the target orientations.
+		for (int32_t effector_i = 0; effector_i < rig.ik->get_effector_count(); effector_i++) {
+			rig.ik->set_pin_direction_priorities(effector_i, Vector3());
+		}
+		rig.ik->set_iterations_per_frame(1000);
+		set_reachable_targets(rig);
+		const real_t error = solve_and_measure(rig, 1);
+		CHECK_MESSAGE(error < SOLVE_PRECISION_TOLERANCE, vformat("Rig %d converged to %f.", rig_i, error));
+		free_rig(rig);
+	}
+}
+
+struct SuperposeTask {
+	PackedVector3Array moved;
+	PackedVector3Array target;
+	Vector<ik_real_t> weight;
+	LocalVector<Quaternion> results;
+
+	void superpose(uint32_t p_index, void *p_userdata) {
+		// QCP takes its inputs by non-const reference, so every task works on its own copy.
+		PackedVector3Array task_moved = moved;
+		PackedVector3Array task_target = target;
+		Vector<ik_real_t> task_weight = weight;
+		QCP qcp(IK_REAL_EPSILON);
+		qcp.set_inner_product_kernel(QCP::get_inner_product_kernel(task_moved.size()));
+		results[p_index] = qcp.weighted_superpose(task_moved, task_target, task_weight, false);
+	}
+};
+
+TEST_CASE("[Modules][ManyBoneIK3D] QCP superposition is bit identical across threads") {
+	SuperposeTask task;
+	Quaternion rotation = Quaternion(Vector3(0.3, 1, -0.2).normalized(), 2.1);
+	for (int32_t heading_i = 0; heading_i < 7; heading_i++) {
+		Vector3 heading = Vector3(Math::sin(heading_i * 1.7), Math::cos(heading_i * 0.9), heading_i * 0.25 - 0.8);
+		task.moved.push_back(heading);
+		task.target.push_back(rotation.xform(heading));
+		task.weight.push_back(1.0 / (heading_i + 1));
+	}
+	const uint32_t count = 64;
+	task.results.resize(count);
+	task.superpose(0, nullptr);
+	Quaternion reference = task.results[0];
+
+	WorkerThreadPool::GroupID group = WorkerThreadPool::get_singleton()->add_template_group_task(&task, &SuperposeTask::superpose, (void *)nullptr, count, -1, true, "QCP determinism test");
+	WorkerThreadPool::get_singleton()->wait_for_group_task_completion(group);
+	for (uint32_t result_i = 0; result_i < count; result_i++) {
+		CHECK(memcmp(&task.results[result_i], &reference, sizeof(Quaternion)) == 0);
+	}
+}
+
+// Runs one frame of full iterations straight on the segments, so the same solve can run on any thread.
+static void solve_segments(TestRig &r_rig) {
+	const int32_t iteration_count = r_rig.ik->get_iterations_per_frame();
+	const ik_real_t default_cos_half_damp = Math::cos(r_rig.ik->get_default_damp() / 2.0);
+	for (int32_t iteration_i = 0; iteration_i < iteration_count; iteration_i++) {
+		for (const Ref<IKBoneSegment3D> &segment : r_rig.ik->get_segmented_skeletons()) {
+			segment->segment_solver(Vector<ik_real_t>(), default_cos_half_damp, false, iteration_i, iteration_count);
+		}
+	}
+}
+
+struct SegmentSolveTask {
+	TestRig *rig = nullptr;
+
+	void solve(void *p_userdata) {
+		solve_segments(*rig);
+	}
+};
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Baking blends by influence and leaves the player as it was") {
+	TestRig rig = create_rig(true);
+	rig.left_target->set_position(Vector3(1.2, 2.6, 0.4));
+	rig.right_target->set_position(Vector3(-1.2, 2.6, 0.4));
+	const String skeleton_path = rig.root->get_path_to(rig.skeleton);
+	const Quaternion sway(Vector3(0, 0, 1), 0.5);
+	Ref<Animation> animation;
+	animation.instantiate();
+	animation->set_length(1.0);
+	int32_t track = animation->add_track(Animation::TYPE_ROTATION_3D);
+	animation->track_set_path(track, NodePath(skeleton_path + ":spine"));
+	animation->rotation_track_insert_key(track, 0.0, Quaternion());
+	animation->rotation_track_insert_key(track, 1.0, sway);
+	Ref<Animation> idle;
+	idle.instantiate();
+	Ref<AnimationLibrary> library;
+	library.instantiate();
+	library->add_animation("sway", animation);
+	library->add_animation("idle", idle);
+	AnimationPlayer *player = memnew(AnimationPlayer);
+	rig.root->add_child(player);
+	player->add_animation_library("", library);
+	player->set_assigned_animation("idle");
+	player->seek(0.25, true);
+
+	Ref<Animation> full = rig.ik->bake_animation(player, "sway", 10.0);
+	REQUIRE(full.is_valid());
+	CHECK(player->get_assigned_animation() == StringName("idle"));
+	CHECK(Math::is_equal_approx(player->get_current_animation_position(), 0.25));
+	const BoneId spine = rig.skeleton->find_bone("spine");
+	CHECK(rig.skeleton->get_bone_pose_rotation(spine).is_equal_approx(Quaternion()));
+
+	rig.ik->set_influence(0.5);
+	Ref<Animation> half = rig.ik->bake_animation(player, "sway", 10.0);
+	rig.ik->set_influence(1.0);
+	rig.ik->set_active(false);
+	Ref<Animation> inactive = rig.ik->bake_animation(player, "sway", 10.0);
+	rig.ik->set_active(true);
+	REQUIRE(half.is_valid());
+	REQUIRE(inactive.is_valid());
+
+	// Half influence lands halfway between the animated pose and the full solve, which moves the arm away from its rest.
+	const NodePath arm_path = NodePath(skeleton_path + ":arm_l");
+	const NodePath spine_path = NodePath(skeleton_path + ":spine");
+	const Quaternion full_arm = full->rotation_track_interpolate(full->find_track(arm_path, Animation::TYPE_ROTATION_3D), 0.5);
+	const Quaternion half_arm = half->rotation_track_interpolate(half->find_track(arm_path, Animation::TYPE_ROTATION_3D), 0.5);
+	CHECK(full_arm.angle_to(Quaternion()) > 0.05);
+	CHECK(half_arm.is_equal_approx(Quaternion().slerp(full_arm, 0.5)));
+	// An inactive modifier bakes every frame's animated pose as it is.
+	const real_t times[] = { 0.0, 0.5, 1.0 };
+	for (const real_t time : times) {
+		CHECK(inactive->rotation_track_interpolate(inactive->find_track(spine_path, Animation::TYPE_ROTATION_3D), time).is_equal_approx(Quaternion().slerp(sway, time)));
+		CHECK(inactive->rotation_track_interpolate(inactive->find_track(arm_path, Animation::TYPE_ROTATION_3D), time).is_equal_approx(Quaternion()));
+	}
+
+	// Without an assigned animation, the player stays unassigned.
+	AnimationPlayer *unassigned = memnew(AnimationPlayer);
+	rig.root->add_child(unassigned);
+	unassigned->add_animation_library("", library);
+	CHECK(rig.ik->bake_animation(unassigned, "sway", 10.0).is_valid());
+	CHECK(unassigned->get_assigned_animation() == StringName());
+	free_rig(rig);
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Editor background solves use the settings they launched with") {
+	Engine::get_singleton()->set_editor_hint(true);
+	TestRig rig = create_rig(false);
+	rig.ik->set("constraint_count", 1);
+	rig.ik->set("constraints/0/bone_name", "spine");
+	rig.left_target->set_position(Vector3(1.2, 2.6, 0.4));
+	rig.right_target->set_position(Vector3(-1.2, 2.6, 0.4));
+	const BoneId hand = rig.skeleton->find_bone("hand_l");
+	const real_t rest_error = rig.skeleton->get_bone_global_pose(hand).origin.distance_to(rig.left_target->get_position());
+
+	// The first update launches the solve; settings changed while it runs only apply to the next one.
+	rig.skeleton->notification(Skeleton3D::NOTIFICATION_UPDATE_SKELETON);
+	rig.ik->set_iterations_per_frame(0);
+	rig.ik->set_default_damp(0.0);
+	rig.ik->set_stabilization_passes(2);
+	real_t solved_error = 0.0;
+	for (const Ref<IKBone3D> &bone : rig.ik->get_bone_list()) {
+		if (bone->get_bone_id() == hand) {
+			solved_error = bone->get_global_pose().origin.distance_to(rig.left_target->get_position());
+		}
+	}
+	CHECK_MESSAGE(solved_error < rest_error * 0.5, "The running solve must keep the iteration count it launched with.");
+
+	// The next update publishes the finished solve, with the constraint frames the gizmo draws from.
+	rig.skeleton->notification(Skeleton3D::NOTIFICATION_UPDATE_SKELETON);
+	const LocalVector<ManyBoneIK3D::PublishedConstraint> &published = rig.ik->get_published_constraints();
+	REQUIRE(published.size() == 1);
+	CHECK(published[0].bone == rig.skeleton->find_bone("spine"));
+	for (const Ref<IKBone3D> &bone : rig.ik->get_bone_list()) {
+		if (bone->get_bone_id() == published[0].bone) {
+			CHECK(published[0].orientation.is_equal_approx(bone->get_constraint_orientation_transform()->get_global_transform()));
+		}
+	}
+	free_rig(rig);
+	Engine::get_singleton()->set_editor_hint(false);
+}
+
+TEST_CASE("[SceneTree][Modules][ManyBoneIK3D] Solving on a worker thread gives bit identical poses") {
+	// The forked rig covers the sorted child segments; the 16 bone chain takes the parallel Jacobi path on the main thread and the inline one on a worker.
+	for (int32_t rig_i = 0; rig_i < 2; rig_i++) {
+		TestRig rigs[2];
+		for (int32_t thread_i = 0; thread_i < 2; thread_i++) {
+			rigs[thread_i] = rig_i == 0 ? create_rig(true) : create_chain_rig(17);
+			rigs[thread_i].ik->set_iteration_scheme(ManyBoneIK3D::ITERATION_SCHEME_JACOBI);
+			rigs[thread_i].left_target->set_position(Vector3(1.2, 2.6, 0.4));
+			if (rig_i == 0) {
+				rigs[thread_i].right_target->set_position(Vector3(-1.0, 3.0, -0.3));
+			}
+			solve_and_hash(rigs[thread_i]);
+		}
+
+		solve_segments(rigs[0]);
+		SegmentSolveTask task;
+		task.rig = &rigs[1];
+		WorkerThreadPool::TaskID task_id = WorkerThreadPool::get_singleton()->add_template_task(&task, &SegmentSolveTask::solve, (void *)nullptr, true, "ManyBoneIK3D worker solve test");
+		WorkerThreadPool::get_singleton()->wait_for_task_completion(task_id);
+
+		Vector<Ref<IKBone3D>> main_bones = rigs[0].ik->get_bone_list();
+		Vector<Ref<IKBone3D>> worker_bones = rigs[1].ik->get_bone_list();
+		REQUIRE(main_bones.size() == worker_bones.size());
+		for (int32_t bone_i = 0; bone_i < main_bones.size(); bone_i++) {
+			Transform3D main_pose = main_bones[bone_i]->get_pose();
+			Transform3D worker_pose = worker_bones[bone_i]->get_pose();
+			CHECK(main_bones[bone_i]->get_bone_id() == worker_bones[bone_i]->get_bone_id());
+			CHECK(memcmp(&main_pose, &worker_pose, sizeof(Transform3D)) == 0);
+		}
+		free_rig(rigs[0]);
+		free_rig(rigs[1]);
+	}
+}
+
+} // namespace TestManyBoneIK3D
+
+#endif // TEST_MANY_BONE_IK_3D_H